@@ -0,0 +1,224 @@
+///
+/// @file blocklist_matcher.hpp
+///
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sqidscxx
+{
+///
+/// Prepare a blocklist for matching IDs over the given alphabet:
+///   1. Remove words with less than 3 characters
+///   2. Remove words that contain characters not in the alphabet
+///   3. Convert words to lowercase
+///
+/// @param words    The blocklist as passed in the options
+/// @param alphabet The alphabet of the IDs
+/// @return         The cleaned up blocklist
+///
+inline std::set<std::string> cleanBlocklist(const std::set<std::string>& words, std::string_view alphabet)
+{
+    const auto lowercase = [](std::string_view input) {
+        std::string result(input);
+        std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+        return result;
+    };
+
+    const std::string lowercaseAlphabet(lowercase(alphabet));
+
+    std::set<std::string> blocklist;
+    for (const std::string& word : words) {
+        if (word.size() < 3) {
+            continue;
+        }
+
+        const std::string lowercaseWord = lowercase(word);
+        if (!std::all_of(lowercaseWord.cbegin(), lowercaseWord.cend(), [&lowercaseAlphabet](auto ch) {
+            return lowercaseAlphabet.find(ch) != std::string::npos;
+        })) {
+            continue;
+        }
+
+        blocklist.insert(lowercaseWord);
+    }
+    return blocklist;
+}
+
+///
+/// @class BlocklistMatcher
+///
+/// @brief Aho-Corasick automaton over a lowercase blocklist.
+///
+/// The automaton is compiled once and then scans a candidate ID in a single
+/// pass, case-insensitively, applying the same rules as the reference
+/// implementation:
+///   - IDs or words of up to 3 characters are blocked only on an exact match
+///   - Words containing digits (leet speak) are blocked only as a prefix or a
+///     suffix of the ID
+///   - Other words are blocked anywhere in the ID
+///
+/// Instances are immutable after construction and safe to share between
+/// threads.
+///
+class BlocklistMatcher
+{
+public:
+    BlocklistMatcher();
+    explicit BlocklistMatcher(const std::set<std::string>& words);
+
+    bool isBlocked(std::string_view id) const;
+
+private:
+    static constexpr uint8_t noColumn = 0xFF;
+    static constexpr size_t shortWordLength = 3;
+
+    struct State
+    {
+        uint32_t fail = 0;
+        uint32_t depth = 0;
+        // A word ends exactly at this state
+        bool terminal = false;
+        // The word ending here is a leet word, blocked when it is the ID prefix
+        bool terminalLeet = false;
+        // Some suffix of this state is a leet word, blocked at the ID end
+        bool leetSuffix = false;
+        // Some suffix of this state is a word blocked anywhere in the ID
+        bool anywhere = false;
+    };
+
+    uint32_t child(uint32_t state, uint8_t column) const;
+
+    std::array<uint8_t, 256> _columns;
+    size_t                   _columnCount = 0;
+    std::vector<uint32_t>    _transitions;
+    std::vector<State>       _states;
+};
+
+inline BlocklistMatcher::BlocklistMatcher()
+  : BlocklistMatcher(std::set<std::string>{})
+{
+}
+
+///
+/// Compile the blocklist. Words are expected to be cleaned up already: at
+/// least 3 characters long and lowercase.
+///
+inline BlocklistMatcher::BlocklistMatcher(const std::set<std::string>& words)
+{
+    _columns.fill(noColumn);
+    for (const std::string& word : words) {
+        for (unsigned char ch : word) {
+            if (_columns[ch] == noColumn) {
+                _columns[ch] = static_cast<uint8_t>(_columnCount++);
+            }
+        }
+    }
+    // Matching is case-insensitive: upper case letters share lower case columns
+    for (unsigned int ch = 0; ch < _columns.size(); ch++) {
+        const auto lower = static_cast<unsigned char>(::tolower(static_cast<int>(ch)));
+        if (lower != ch && _columns[ch] == noColumn) {
+            _columns[ch] = _columns[lower];
+        }
+    }
+
+    // Build the trie; state 0 is the root
+    _states.emplace_back();
+    _transitions.assign(_columnCount, 0);
+
+    for (const std::string& word : words) {
+        uint32_t state = 0;
+        for (unsigned char ch : word) {
+            const uint8_t column = _columns[ch];
+            uint32_t next = _transitions[state * _columnCount + column];
+            if (next == 0) {
+                next = static_cast<uint32_t>(_states.size());
+                State created;
+                created.depth = _states[state].depth + 1;
+                _states.push_back(created);
+                _transitions.resize(_transitions.size() + _columnCount, 0);
+                _transitions[state * _columnCount + column] = next;
+            }
+            state = next;
+        }
+
+        State& last = _states[state];
+        last.terminal = true;
+        if (word.size() > shortWordLength) {
+            const bool leet = std::any_of(word.cbegin(), word.cend(), ::isdigit);
+            last.terminalLeet = leet;
+            last.leetSuffix = leet;
+            last.anywhere = !leet;
+        }
+    }
+
+    // Breadth-first pass: fill failure links and turn the trie into a DFA
+    std::deque<uint32_t> queue;
+    for (size_t column = 0; column < _columnCount; column++) {
+        const uint32_t next = _transitions[column];
+        if (next != 0) {
+            queue.push_back(next);
+        }
+    }
+
+    while (!queue.empty()) {
+        const uint32_t state = queue.front();
+        queue.pop_front();
+
+        State& current = _states[state];
+        const State& fail = _states[current.fail];
+        current.leetSuffix = current.leetSuffix || fail.leetSuffix;
+        current.anywhere = current.anywhere || fail.anywhere;
+
+        for (size_t column = 0; column < _columnCount; column++) {
+            uint32_t& next = _transitions[state * _columnCount + column];
+            const uint32_t fallback = _transitions[current.fail * _columnCount + column];
+            if (next != 0) {
+                _states[next].fail = fallback;
+                queue.push_back(next);
+            } else {
+                next = fallback;
+            }
+        }
+    }
+}
+
+inline uint32_t BlocklistMatcher::child(uint32_t state, uint8_t column) const
+{
+    return column == noColumn ? 0 : _transitions[state * _columnCount + column];
+}
+
+///
+/// Check whether an ID contains a blocked word.
+///
+/// @param id  The candidate ID, in any letter case
+/// @return    `true` when the ID must be regenerated
+///
+inline bool BlocklistMatcher::isBlocked(std::string_view id) const
+{
+    const size_t idLength = id.size();
+    const bool longId = idLength > shortWordLength;
+
+    uint32_t state = 0;
+    for (size_t i = 0; i < idLength; i++) {
+        state = child(state, _columns[static_cast<unsigned char>(id[i])]);
+        const State& current = _states[state];
+
+        if (longId && (current.anywhere || (current.terminalLeet && current.depth == i + 1))) {
+            return true;
+        }
+    }
+
+    const State& last = _states[state];
+    return (longId && last.leetSuffix) || (last.terminal && last.depth == idLength);
+}
+
+} // namespace sqidscxx
@@ -36,6 +36,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <iostream>
@@ -43,8 +44,10 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "blocklist.hpp"
+#include "blocklist_matcher.hpp"
 
 namespace sqidscxx
 {
@@ -109,32 +112,54 @@ public:
     bool containsMultibyteCharacters(const std::string& input) const;
 
     std::string encode(const std::vector<T>& numbers) const;
+    size_t encodeInto(const T* numbers, size_t count, char* buffer, size_t capacity) const;
+    size_t encodeInto(T number, char* buffer, size_t capacity) const;
     std::vector<T> decode(std::string_view id) const;
+    size_t decodeInto(std::string_view id, T* numbers, size_t capacity) const;
+
+    bool isWellFormed(std::string_view id) const;
+
+    size_t maxLength(size_t count) const;
 
     static constexpr T maxValue = std::numeric_limits<T>::max();
 
+    ///
+    /// Buffer capacity that fits the ID of a single number for any options.
+    ///
+    static constexpr size_t maxSingleIdLength = std::numeric_limits<uint8_t>::max();
+
 private:
-    struct Encoder
-    {
-        Encoder(const Sqids<T>* _sqids, const std::vector<T>& _numbers);
+    ///
+    /// Alphabets are limited to unique single-byte characters, so the working
+    /// copy of the alphabet always fits a buffer of this size.
+    ///
+    static constexpr size_t maxAlphabetLength = 128;
 
-        const Sqids<T>* const sqids;
-        std::vector<T> numbers;
+    static constexpr uint8_t noIndex = 0xFF;
 
-        std::string run(unsigned int increment = 0);
-    };
+    ///
+    /// How many numbers isWellFormed() checks without a heap allocation.
+    ///
+    static constexpr size_t wellFormedCapacity = 4;
 
-    std::string lowercaseString(const std::string& input) const;
+    static_assert(1 + std::numeric_limits<T>::digits <= maxSingleIdLength,
+                  "An ID of a single number must fit maxSingleIdLength");
 
     void shuffle(std::string& alphabet) const;
+    void shuffle(char* alphabet, size_t length) const;
 
-    std::string toId(T number, const std::string& alphabet) const;
-    T toNumber(const std::string& id, const std::string& alphabet) const;
-    bool isBlockedId(const std::string& id) const;
+    size_t encodeAttempt(const T* numbers, size_t count, unsigned int increment, char* buffer) const;
+    size_t toId(T number, const char* alphabet, size_t alphabetLength, char* buffer) const;
+    bool toNumber(std::string_view id, const uint8_t* index, size_t base, T& number) const;
+    bool isBlockedId(std::string_view id) const;
 
-    std::string           _alphabet;
-    std::set<std::string> _blocklist;
-    uint8_t               _minLength;
+    std::string      _alphabet;
+    BlocklistMatcher _blocklist;
+    uint8_t          _minLength;
+    size_t           _maxNumberLength;
+
+    // Position of every character in `_alphabet`, `noIndex` for the rest
+    std::array<uint8_t, 256> _alphabetIndex;
 };
 
 ///
@@ -172,15 +197,6 @@ inline constexpr std::vector<T> Sqids<T>::numbers(std::initializer_list<T>&& val
     return std::vector<T>(std::move(values));
 }
 
-template<typename T>
-inline std::string Sqids<T>::lowercaseString(const std::string& input) const
-{
-    std::string lowercaseString;
-    lowercaseString.resize(input.size());
-    std::transform(input.cbegin(), input.cend(), lowercaseString.begin(), ::tolower);
-    return lowercaseString;
-}
-
 ///
 /// Sqids constructor.
 ///
@@ -213,29 +229,21 @@ Sqids<T>::Sqids(const SqidsOptions& options)
         throw std::runtime_error("Alphabet must not contain duplicate characters.");
     }
 
-    const std::string lowercaseAlphabet(lowercaseString(options.alphabet));
+    // Compile the blocklist once, so that every check is a single pass over the ID
+    _blocklist = BlocklistMatcher(cleanBlocklist(options.blocklist, options.alphabet));
 
-    // Clean up blocklist
-    for (const std::string& word : options.blocklist) {
-        // 1. Remove words with less than 3 characters
-        if (word.size() < 3) {
-            continue;
-        }
-
-        const std::string lowercaseWord = lowercaseString(word);
-
-        // 2. Remove words that contain characters not in the alphabet
-        if (!std::all_of(lowercaseWord.cbegin(), lowercaseWord.cend(), [lowercaseAlphabet](auto ch) {
-            return lowercaseAlphabet.find(ch) != std::string::npos;
-        })) {
-            continue;
-        }
-
-        // 3. Convert words to lowercase
-        _blocklist.insert(lowercaseWord);
+    // The longest number is `maxValue` written without the separator character
+    _maxNumberLength = 0;
+    for (T value = maxValue; value > 0; value /= (alphabetSize - 1)) {
+        _maxNumberLength++;
     }
 
     shuffle(_alphabet);
+
+    _alphabetIndex.fill(noIndex);
+    for (size_t i = 0; i < alphabetSize; i++) {
+        _alphabetIndex[static_cast<unsigned char>(_alphabet[i])] = static_cast<uint8_t>(i);
+    }
 }
 
 template<typename T>
@@ -270,9 +278,37 @@ std::string Sqids<T>::encode(const std::vector<T>& numbers) const
         return "";
     }
 
+    std::string id(maxLength(numbers.size()), '\0');
+    id.resize(encodeInto(numbers.data(), numbers.size(), id.data(), id.size()));
+    return id;
+}
+
+///
+/// Encode a sequence of integers into a caller-provided buffer without any
+/// heap allocation. The buffer is not null-terminated.
+///
+/// Fails in the same cases as encode(), and additionally when `capacity` is
+/// smaller than `maxLength(count)`.
+///
+/// @throws std::runtime_error When encoding fails
+///
+/// @param numbers  The integers to encode into an ID
+/// @param count    The number of integers
+/// @param buffer   Output buffer for the ID
+/// @param capacity Size of the output buffer
+/// @return         The length of the generated ID
+///
+template<typename T>
+size_t Sqids<T>::encodeInto(const T* numbers, size_t count, char* buffer, size_t capacity) const
+{
+    // If no numbers were passed, the ID is empty
+    if (count == 0) {
+        return 0;
+    }
+
     // Don't allow out-of-range numbers
-    for (auto it = numbers.cbegin(); it != numbers.cend(); ++it) {
-        if (*it < 0 || *it > maxValue) {
+    for (size_t i = 0; i < count; i++) {
+        if (numbers[i] < 0 || numbers[i] > maxValue) {
             std::ostringstream stream;
             stream << "Encoding supports numbers between 0 and " << maxValue;
 
@@ -280,7 +316,45 @@ std::string Sqids<T>::encode(const std::vector<T>& numbers) const
         }
     }
 
-    return Encoder(this, numbers).run();
+    if (capacity < maxLength(count)) {
+        throw std::runtime_error("Buffer is too small to hold the encoded ID.");
+    }
+
+    // if ID has a blocked word anywhere, restart with a +1 increment
+    for (unsigned int increment = 0; increment <= _alphabet.size(); increment++) {
+        const size_t length = encodeAttempt(numbers, count, increment, buffer);
+        if (!isBlockedId(std::string_view(buffer, length))) {
+            return length;
+        }
+    }
+
+    throw std::runtime_error("Reached max attempts to re-generate the ID.");
+}
+
+///
+/// @overload
+///
+template<typename T>
+inline size_t Sqids<T>::encodeInto(T number, char* buffer, size_t capacity) const
+{
+    return encodeInto(&number, 1, buffer, capacity);
+}
+
+///
+/// The buffer capacity that is always enough to encode `count` numbers.
+///
+/// @param count The number of integers to encode
+/// @return      Upper bound of the ID length
+///
+template<typename T>
+inline size_t Sqids<T>::maxLength(size_t count) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    // Prefix, the numbers and the separators between them
+    const size_t length = 1 + count * _maxNumberLength + (count - 1);
+    return std::max<size_t>(length, _minLength);
 }
 
 ///
@@ -295,87 +369,149 @@ std::string Sqids<T>::encode(const std::vector<T>& numbers) const
 ///
 template<typename T>
 typename std::vector<T> Sqids<T>::decode(std::string_view id) const
+{
+    // Every number takes at least one character of the ID
+    std::vector<T> numbers(id.size());
+    numbers.resize(std::min(decodeInto(id, numbers.data(), numbers.size()), numbers.size()));
+    return numbers;
+}
+
+///
+/// Decode an ID into a caller-provided array without any heap allocation.
+///
+/// Returns 0 in the same cases where decode() returns an empty sequence, and
+/// when a number in the ID does not fit `T`. At most `capacity` numbers are
+/// written, but the returned value is always the count of numbers in the ID,
+/// so a result greater than `capacity` means the output was truncated.
+///
+/// @param id       The ID to decode
+/// @param numbers  Output array for the decoded integers
+/// @param capacity Size of the output array
+/// @return         The count of numbers in the ID
+///
+template<typename T>
+size_t Sqids<T>::decodeInto(std::string_view id, T* numbers, size_t capacity) const
 {
     // If an empty string is given, return an empty sequence
     if (id.empty()) {
-        return {};
+        return 0;
     }
 
     // If a character is not in the alphabet, return an empty sequence
-    for (auto ch : id) {
-        if (_alphabet.find(ch) == std::string::npos) {
-            return {};
+    for (unsigned char ch : id) {
+        if (_alphabetIndex[ch] == noIndex) {
+            return 0;
         }
     }
 
-    std::vector<T> numbers;
-
-    // First character is always the `prefix`
-    const auto prefix = id[0];
+    const size_t alphabetSize = _alphabet.size();
 
-    // `offset` is the semi-random position that was generated during encoding
-    const auto offset = _alphabet.find(prefix);
+    // `offset` is the semi-random position that was generated during
+    // encoding, the first character is always the `prefix`
+    const size_t offset = _alphabetIndex[static_cast<unsigned char>(id[0])];
 
-    // Re-arrange alphabet back into it's original form
-    std::string alphabet(_alphabet.substr(offset) + _alphabet.substr(0, offset));
+    // Re-arrange alphabet back into it's original form and reverse it
+    char alphabet[maxAlphabetLength];
+    const char* source = _alphabet.data();
+    std::reverse_copy(source + offset, source + alphabetSize,
+                      std::reverse_copy(source, source + offset, alphabet));
 
-    // Reverse alphabet
-    std::reverse(alphabet.begin(), alphabet.end());
+    // Position of every character in the working alphabet. Only alphabet
+    // characters are looked up, the ID has been validated above.
+    uint8_t index[256];
+    for (size_t i = 0; i < alphabetSize; i++) {
+        index[static_cast<unsigned char>(alphabet[i])] = static_cast<uint8_t>(i);
+    }
 
     // Remove the prefix character from the ID since it is not needed anymore
-    std::string slicedId(id.substr(1));
+    std::string_view slicedId(id.substr(1));
+    size_t count = 0;
 
     // Decode
-    while (slicedId.size() > 0) {
+    while (!slicedId.empty()) {
         const auto separator = alphabet[0];
 
-        std::vector<std::string> chunks;
-        size_t start = 0,
-               end = 0;
-
         // We need the first part to the left of the separator to decode the number
-        while ((end = slicedId.find(separator, start)) != std::string::npos) {
-            chunks.push_back(slicedId.substr(start, end - start));
-            start = end + 1;
+        const size_t end = slicedId.find(separator);
+        const std::string_view chunk = slicedId.substr(0, end);
+        if (chunk.empty()) {
+            return count;
         }
-        chunks.push_back(slicedId.substr(start));
 
-        if (chunks.size() > 0) {
-            if (chunks[0].empty()) {
-                return numbers;
-            }
+        // Decode the number without using the `separator` character
+        T number = 0;
+        if (!toNumber(chunk, index, alphabetSize - 1, number)) {
+            return 0;
+        }
+        if (count < capacity) {
+            numbers[count] = number;
+        }
+        count++;
 
-            // Decode the number without using the `separator` character
-            numbers.push_back(toNumber(chunks[0], alphabet.substr(1)));
+        if (end == std::string_view::npos) {
+            break;
+        }
 
-            // If this ID has multiple numbers, shuffle the alphabet, just as
-            // the encoding function does
-            if (chunks.size() > 1) {
-                shuffle(alphabet);
-            }
+        // If this ID has multiple numbers, shuffle the alphabet, just as
+        // the encoding function does
+        shuffle(alphabet, alphabetSize);
+        for (size_t i = 0; i < alphabetSize; i++) {
+            index[static_cast<unsigned char>(alphabet[i])] = static_cast<uint8_t>(i);
         }
 
         // The `id` is now going to be everything to the right of the `separator`
-        slicedId.clear();
-        chunks.erase(chunks.begin());
-
-        const size_t chunksCount = chunks.size();
-        for (unsigned int i = 0; i < chunksCount; i++) {
-            slicedId += chunks[i];
-            if (i < chunksCount - 1) {
-                slicedId += separator;
-            }
-        }
+        slicedId.remove_prefix(end + 1);
     }
 
-    return numbers;
+    return count;
 }
 
+///
+/// Check that an ID is exactly what encode() produces for the numbers it
+/// decodes to. This rejects IDs with foreign characters, broken structure,
+/// wrong padding or overflowing numbers, as well as IDs produced with other
+/// options. IDs of up to `wellFormedCapacity` numbers are checked without a
+/// heap allocation.
+///
+/// @param id  The ID to check
+/// @return    `true` when the ID is the canonical encoding of its numbers
+///
 template<typename T>
-void Sqids<T>::shuffle(std::string& alphabet) const
+bool Sqids<T>::isWellFormed(std::string_view id) const
 {
-    const auto length = alphabet.size();
+    T numbers[wellFormedCapacity];
+    const size_t count = decodeInto(id, numbers, wellFormedCapacity);
+    if (count == 0) {
+        return false;
+    }
+
+    // A canonical ID is never longer than the bound for its numbers
+    if (id.size() > maxLength(count)) {
+        return false;
+    }
 
+    try {
+        if (count > wellFormedCapacity) {
+            return encode(decode(id)) == id;
+        }
+
+        char buffer[std::max(maxSingleIdLength, 1 + wellFormedCapacity * (std::numeric_limits<T>::digits + 1))];
+        const size_t length = encodeInto(numbers, count, buffer, sizeof(buffer));
+        return std::string_view(buffer, length) == id;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+template<typename T>
+inline void Sqids<T>::shuffle(std::string& alphabet) const
+{
+    shuffle(alphabet.data(), alphabet.size());
+}
+
+template<typename T>
+void Sqids<T>::shuffle(char* alphabet, size_t length) const
+{
     // In-place shuffle which always produces the same result, given the same
     // alphabet
     for (unsigned int i = 0, j = length - 1; j > 0; i++, j--) {
@@ -385,141 +521,104 @@ void Sqids<T>::shuffle(std::string& alphabet) const
 }
 
 template<typename T>
-std::string Sqids<T>::toId(T number, const std::string& alphabet) const
+size_t Sqids<T>::toId(T number, const char* alphabet, size_t alphabetLength, char* buffer) const
 {
-    std::string id;
-    const size_t alphabetLength = alphabet.size();
+    size_t length = 0;
 
     do {
-        id.append(1, alphabet[number % alphabetLength]);
+        buffer[length++] = alphabet[number % alphabetLength];
         number = number / alphabetLength;
     } while (number > 0);
 
-    std::reverse(id.begin(), id.end());
+    std::reverse(buffer, buffer + length);
 
-    return id;
+    return length;
 }
 
 template<typename T>
-T Sqids<T>::toNumber(const std::string& id, const std::string& alphabet) const
+bool Sqids<T>::toNumber(std::string_view id, const uint8_t* index, size_t base, T& number) const
 {
-    const size_t alphabetSize = alphabet.size();
+    const T radix = static_cast<T>(base);
     T a = 0;
 
-    for (auto ch : id) {
-        a = a * alphabetSize + alphabet.find(ch);
-    }
-
-    return a;
-}
-
-template<typename T>
-bool Sqids<T>::isBlockedId(const std::string& id) const
-{
-    const size_t idLength = id.size();
-
-    auto lowercaseId(lowercaseString(id));
-
-    for (const std::string& word : _blocklist) {
-        const size_t wordLength = word.size();
-        // No point in checking words that are longer than the ID
-        if (wordLength <= idLength) {
-            if (idLength <= 3 || wordLength <= 3) {
-                // Short words have to match completely; otherwise, too many matches
-                if (lowercaseId == word) {
-                    return true;
-                }
-            } else if (std::any_of(word.cbegin(), word.cend(), ::isdigit)) {
-                // Words with leet speak replacements are visible mostly at the
-                // ends of the ID
-                if (lowercaseId.find(word) == 0 || lowercaseId.rfind(word) == idLength - wordLength) {
-                    return true;
-                }
-            } else if (lowercaseId.find(word) != std::string::npos) {
-                // Otherwise, check for blocked word anywhere in the string
-                return true;
-            }
+    for (unsigned char ch : id) {
+        // Digits are positions in the alphabet without the leading separator
+        const T digit = index[ch] - 1;
+        if (a > (maxValue - digit) / radix) {
+            return false;
         }
+        a = a * radix + digit;
     }
 
-    return false;
+    number = a;
+    return true;
 }
 
 template<typename T>
-Sqids<T>::Encoder::Encoder(const Sqids<T>* _sqids, const std::vector<T>& _numbers)
-  : sqids(_sqids),
-    numbers(_numbers)
+inline bool Sqids<T>::isBlockedId(std::string_view id) const
 {
+    return _blocklist.isBlocked(id);
 }
 
 template<typename T>
-std::string Sqids<T>::Encoder::run(unsigned int increment)
+size_t Sqids<T>::encodeAttempt(const T* numbers, size_t count, unsigned int increment, char* buffer) const
 {
-    const size_t alphabetSize = sqids->_alphabet.size();
-
-    if (increment > alphabetSize) {
-        throw std::runtime_error("Reached max attempts to re-generate the ID.");
-    }
+    const size_t alphabetSize = _alphabet.size();
 
     // Get a semi-random offset from input numbers
-    auto a = numbers.size();
+    auto a = count;
 
-    for (unsigned int i = 0; i < numbers.size(); i++) {
+    for (unsigned int i = 0; i < count; i++) {
         const T v = numbers[i];
-        a += i + sqids->_alphabet[v % alphabetSize];
+        a += i + _alphabet[v % alphabetSize];
     }
 
     const auto offset = (a + increment) % alphabetSize;
 
-    // Re-arrange alphabet so that second-half goes in front of the first-half
-    std::string alphabet(sqids->_alphabet.substr(offset) + sqids->_alphabet.substr(0, offset));
-
-    // `prefix` is the first character in the generated ID, used for randomization
-    const auto prefix = alphabet[0];
-
-    // Reverse alphabet
-    std::reverse(alphabet.begin(), alphabet.end());
+    // Re-arrange alphabet so that second-half goes in front of the first-half,
+    // then reverse it. Both steps are done at once by copying the two halves
+    // backwards into the working buffer.
+    char alphabet[maxAlphabetLength];
+    const char* source = _alphabet.data();
+    std::reverse_copy(source + offset, source + alphabetSize,
+                      std::reverse_copy(source, source + offset, alphabet));
 
-    // The final ID will always have the `prefix` character at the beginning
-    std::string id = { prefix };
+    // The final ID will always have the `prefix` character at the beginning,
+    // used for randomization
+    size_t length = 0;
+    buffer[length++] = _alphabet[offset];
 
     // Encode the input array
-    for (auto it = numbers.cbegin(); it != numbers.cend(); ++it) {
-
-	// The first character of the alphabet is going to be reserved for the `separator`
-	const auto alphabetWithoutSeparator = alphabet.substr(1);
-
-	id += sqids->toId(*it, alphabetWithoutSeparator);
+    for (size_t i = 0; i < count; i++) {
+        // The first character of the alphabet is going to be reserved for the `separator`
+        length += toId(numbers[i], alphabet + 1, alphabetSize - 1, buffer + length);
 
         // If not the last number
-        if (std::next(it) != numbers.cend()) {
+        if (i + 1 < count) {
             // `separator` character is used to isolate numbers within the ID
-            id.push_back(alphabet[0]);
+            buffer[length++] = alphabet[0];
 
-	    // Shuffle on every iteration
-	    sqids->shuffle(alphabet);
+            // Shuffle on every iteration
+            shuffle(alphabet, alphabetSize);
         }
     }
 
     // Handle `minLength` requirement, if the ID is too short
-    if (sqids->_minLength > id.size()) {
+    if (_minLength > length) {
         // Append a separator
-        id.push_back(alphabet[0]);
+        buffer[length++] = alphabet[0];
 
         // For decoding: two separators next to each other is what tells us the
         // rest are junk characters
-        while (sqids->_minLength - id.size() > 0) {
-	    sqids->shuffle(alphabet);
-            id += alphabet.substr(0, std::min(sqids->_minLength - id.size(), alphabet.size()));
+        while (_minLength > length) {
+            shuffle(alphabet, alphabetSize);
+            const size_t chunk = std::min<size_t>(_minLength - length, alphabetSize);
+            std::copy(alphabet, alphabet + chunk, buffer + length);
+            length += chunk;
         }
     }
 
-    // if ID has a blocked word anywhere, restart with a +1 increment
-    if (sqids->isBlockedId(id)) {
-        return run(increment + 1);
-    }
-
-    return id;
+    return length;
 }
 
 } // namespace sqidscxx
@@ -0,0 +1,487 @@
+///
+/// @file static_sqids.hpp
+///
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "blocklist.hpp"
+#include "blocklist_matcher.hpp"
+
+namespace sqidscxx
+{
+namespace detail
+{
+constexpr size_t alphabetLength(const char* alphabet)
+{
+    size_t length = 0;
+    while (alphabet[length] != '\0') {
+        length++;
+    }
+    return length;
+}
+
+constexpr bool isValidAlphabet(const char* alphabet)
+{
+    const size_t length = alphabetLength(alphabet);
+    for (size_t i = 0; i < length; i++) {
+        // Alphabet cannot contain multibyte characters
+        if (static_cast<unsigned char>(alphabet[i]) >= 0x80) {
+            return false;
+        }
+        // All the characters in the alphabet must be unique
+        for (size_t j = i + 1; j < length; j++) {
+            if (alphabet[i] == alphabet[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Same in-place shuffle as Sqids::shuffle, usable in constant expressions
+template<size_t N>
+constexpr void shuffle(std::array<char, N>& alphabet)
+{
+    for (unsigned int i = 0, j = N - 1; j > 0; i++, j--) {
+        const auto r = (i * j + alphabet[i] + alphabet[j]) % N;
+        const char swapped = alphabet[i];
+        alphabet[i] = alphabet[r];
+        alphabet[r] = swapped;
+    }
+}
+} // namespace detail
+
+///
+/// @class StaticSqids
+///
+/// @brief Sqids with the alphabet and minimum length fixed at compile time.
+///
+/// Produces exactly the same IDs as `Sqids<T>` created with the same
+/// alphabet and `minLength`. The shuffled alphabet, the reverse lookup table,
+/// and for every prefix offset the rotated alphabet and its first shuffle are
+/// computed `constexpr`, so encoding and decoding a single number are table
+/// lookups and divisions by a constant. Only the blocklist is compiled at
+/// run time, once per instance.
+///
+/// The alphabet must be a `constexpr` character array with static storage:
+///
+/// @code
+/// inline constexpr char kAlphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+/// const sqidscxx::StaticSqids<int64_t, kAlphabet, 15> sqids;
+/// auto id = sqids.encode({ 1 });
+/// @endcode
+///
+template<typename T, const char* Alphabet, uint8_t MinLength = 0>
+class StaticSqids
+{
+public:
+    static constexpr size_t alphabetSize = detail::alphabetLength(Alphabet);
+
+    static_assert(alphabetSize >= 3, "Alphabet length must be at least 3.");
+    static_assert(detail::isValidAlphabet(Alphabet),
+                  "Alphabet must consist of unique single-byte characters.");
+
+    explicit StaticSqids(const std::set<std::string>& blocklist = DEFAULT_BLOCKLIST);
+
+    std::string encode(const std::vector<T>& numbers) const;
+    size_t encodeInto(const T* numbers, size_t count, char* buffer, size_t capacity) const;
+    size_t encodeInto(T number, char* buffer, size_t capacity) const;
+
+    std::vector<T> decode(std::string_view id) const;
+    size_t decodeInto(std::string_view id, T* numbers, size_t capacity) const;
+
+    bool isWellFormed(std::string_view id) const;
+
+    static constexpr size_t maxLength(size_t count);
+
+    static constexpr T maxValue = std::numeric_limits<T>::max();
+
+    ///
+    /// Buffer capacity that fits the ID of a single number.
+    ///
+    static constexpr size_t maxSingleIdLength = std::numeric_limits<uint8_t>::max();
+
+private:
+    static constexpr uint8_t noIndex = 0xFF;
+    static constexpr size_t wellFormedCapacity = 4;
+
+    using AlphabetArray = std::array<char, alphabetSize>;
+    // IDs are validated before decoding, so only single-byte characters are looked up
+    using IndexArray = std::array<uint8_t, 128>;
+
+    struct Tables
+    {
+        AlphabetArray                           alphabet{};
+        std::array<uint8_t, 256>                alphabetIndex{};
+        std::array<AlphabetArray, alphabetSize> rotated{};
+        std::array<IndexArray, alphabetSize>    rotatedIndex{};
+        std::array<AlphabetArray, alphabetSize> shuffled{};
+        std::array<IndexArray, alphabetSize>    shuffledIndex{};
+    };
+
+    static constexpr IndexArray makeIndex(const AlphabetArray& alphabet);
+    static constexpr Tables makeTables();
+    static constexpr size_t maxNumberLength();
+
+    static constexpr Tables tables = makeTables();
+
+    // Every shuffle of the working alphabet after the first one is done at run time
+    struct Working
+    {
+        const char*    alphabet;
+        const uint8_t* index;
+        unsigned int   shuffles;
+        AlphabetArray  alphabetCopy;
+        IndexArray     indexCopy;
+
+        explicit Working(size_t offset);
+        void shuffle(size_t offset, bool withIndex);
+    };
+
+    size_t encodeAttempt(const T* numbers, size_t count, unsigned int increment, char* buffer) const;
+    static size_t toId(T number, const char* alphabet, char* buffer);
+    static bool toNumber(std::string_view id, const uint8_t* index, T& number);
+
+    BlocklistMatcher _blocklist;
+};
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+constexpr typename StaticSqids<T, Alphabet, MinLength>::IndexArray
+StaticSqids<T, Alphabet, MinLength>::makeIndex(const AlphabetArray& alphabet)
+{
+    IndexArray index{};
+    for (size_t i = 0; i < index.size(); i++) {
+        index[i] = noIndex;
+    }
+    for (size_t i = 0; i < alphabetSize; i++) {
+        index[static_cast<unsigned char>(alphabet[i])] = static_cast<uint8_t>(i);
+    }
+    return index;
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+constexpr typename StaticSqids<T, Alphabet, MinLength>::Tables StaticSqids<T, Alphabet, MinLength>::makeTables()
+{
+    Tables result{};
+
+    for (size_t i = 0; i < alphabetSize; i++) {
+        result.alphabet[i] = Alphabet[i];
+    }
+    detail::shuffle(result.alphabet);
+
+    for (size_t i = 0; i < result.alphabetIndex.size(); i++) {
+        result.alphabetIndex[i] = noIndex;
+    }
+    for (size_t i = 0; i < alphabetSize; i++) {
+        result.alphabetIndex[static_cast<unsigned char>(result.alphabet[i])] = static_cast<uint8_t>(i);
+    }
+
+    for (size_t offset = 0; offset < alphabetSize; offset++) {
+        // Alphabet rotated so that `offset` goes first, then reversed
+        for (size_t i = 0; i < alphabetSize; i++) {
+            result.rotated[offset][i] = result.alphabet[(offset + alphabetSize - 1 - i) % alphabetSize];
+        }
+        result.rotatedIndex[offset] = makeIndex(result.rotated[offset]);
+
+        result.shuffled[offset] = result.rotated[offset];
+        detail::shuffle(result.shuffled[offset]);
+        result.shuffledIndex[offset] = makeIndex(result.shuffled[offset]);
+    }
+
+    return result;
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+constexpr size_t StaticSqids<T, Alphabet, MinLength>::maxNumberLength()
+{
+    // The longest number is `maxValue` written without the separator character
+    size_t length = 0;
+    for (T value = maxValue; value > 0; value /= (alphabetSize - 1)) {
+        length++;
+    }
+    return length;
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+StaticSqids<T, Alphabet, MinLength>::Working::Working(size_t offset)
+  : alphabet(tables.rotated[offset].data()),
+    index(tables.rotatedIndex[offset].data()),
+    shuffles(0)
+{
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+void StaticSqids<T, Alphabet, MinLength>::Working::shuffle(size_t offset, bool withIndex)
+{
+    if (shuffles == 0) {
+        alphabet = tables.shuffled[offset].data();
+        index = tables.shuffledIndex[offset].data();
+    } else {
+        if (shuffles == 1) {
+            alphabetCopy = tables.shuffled[offset];
+            alphabet = alphabetCopy.data();
+        }
+        detail::shuffle(alphabetCopy);
+        if (withIndex) {
+            indexCopy = makeIndex(alphabetCopy);
+            index = indexCopy.data();
+        }
+    }
+    shuffles++;
+}
+
+///
+/// StaticSqids constructor.
+///
+/// @param blocklist A list of words that must never appear in IDs
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+StaticSqids<T, Alphabet, MinLength>::StaticSqids(const std::set<std::string>& blocklist)
+  : _blocklist(cleanBlocklist(blocklist, std::string_view(Alphabet, alphabetSize)))
+{
+}
+
+///
+/// The buffer capacity that is always enough to encode `count` numbers.
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+constexpr size_t StaticSqids<T, Alphabet, MinLength>::maxLength(size_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+    // Prefix, the numbers and the separators between them
+    const size_t length = 1 + count * maxNumberLength() + (count - 1);
+    return std::max<size_t>(length, MinLength);
+}
+
+///
+/// Encode a sequence of integers into an ID.
+///
+/// @throws std::runtime_error When encoding fails, see Sqids::encode()
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+std::string StaticSqids<T, Alphabet, MinLength>::encode(const std::vector<T>& numbers) const
+{
+    if (numbers.empty()) {
+        return "";
+    }
+
+    std::string id(maxLength(numbers.size()), '\0');
+    id.resize(encodeInto(numbers.data(), numbers.size(), id.data(), id.size()));
+    return id;
+}
+
+///
+/// Encode a sequence of integers into a caller-provided buffer without any
+/// heap allocation.
+///
+/// @throws std::runtime_error When encoding fails, see Sqids::encodeInto()
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+size_t StaticSqids<T, Alphabet, MinLength>::encodeInto(const T* numbers, size_t count, char* buffer, size_t capacity) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (numbers[i] < 0 || numbers[i] > maxValue) {
+            std::ostringstream stream;
+            stream << "Encoding supports numbers between 0 and " << maxValue;
+
+            throw std::runtime_error(stream.str());
+        }
+    }
+
+    if (capacity < maxLength(count)) {
+        throw std::runtime_error("Buffer is too small to hold the encoded ID.");
+    }
+
+    for (unsigned int increment = 0; increment <= alphabetSize; increment++) {
+        const size_t length = encodeAttempt(numbers, count, increment, buffer);
+        if (!_blocklist.isBlocked(std::string_view(buffer, length))) {
+            return length;
+        }
+    }
+
+    throw std::runtime_error("Reached max attempts to re-generate the ID.");
+}
+
+///
+/// @overload
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+inline size_t StaticSqids<T, Alphabet, MinLength>::encodeInto(T number, char* buffer, size_t capacity) const
+{
+    return encodeInto(&number, 1, buffer, capacity);
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+size_t StaticSqids<T, Alphabet, MinLength>::encodeAttempt(const T* numbers, size_t count, unsigned int increment, char* buffer) const
+{
+    auto a = count;
+    for (unsigned int i = 0; i < count; i++) {
+        a += i + tables.alphabet[numbers[i] % alphabetSize];
+    }
+    const size_t offset = (a + increment) % alphabetSize;
+
+    Working working(offset);
+
+    size_t length = 0;
+    buffer[length++] = tables.alphabet[offset];
+
+    for (size_t i = 0; i < count; i++) {
+        length += toId(numbers[i], working.alphabet + 1, buffer + length);
+
+        if (i + 1 < count) {
+            buffer[length++] = working.alphabet[0];
+            working.shuffle(offset, false);
+        }
+    }
+
+    if (MinLength > length) {
+        buffer[length++] = working.alphabet[0];
+
+        while (MinLength > length) {
+            working.shuffle(offset, false);
+            const size_t chunk = std::min<size_t>(MinLength - length, alphabetSize);
+            std::copy(working.alphabet, working.alphabet + chunk, buffer + length);
+            length += chunk;
+        }
+    }
+
+    return length;
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+size_t StaticSqids<T, Alphabet, MinLength>::toId(T number, const char* alphabet, char* buffer)
+{
+    constexpr T base = alphabetSize - 1;
+    size_t length = 0;
+
+    do {
+        buffer[length++] = alphabet[number % base];
+        number = number / base;
+    } while (number > 0);
+
+    std::reverse(buffer, buffer + length);
+
+    return length;
+}
+
+///
+/// Decode an ID back into a sequence of integers, see Sqids::decode().
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+std::vector<T> StaticSqids<T, Alphabet, MinLength>::decode(std::string_view id) const
+{
+    std::vector<T> numbers(id.size());
+    numbers.resize(std::min(decodeInto(id, numbers.data(), numbers.size()), numbers.size()));
+    return numbers;
+}
+
+///
+/// Decode an ID into a caller-provided array without any heap allocation,
+/// see Sqids::decodeInto().
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+size_t StaticSqids<T, Alphabet, MinLength>::decodeInto(std::string_view id, T* numbers, size_t capacity) const
+{
+    if (id.empty()) {
+        return 0;
+    }
+
+    for (unsigned char ch : id) {
+        if (tables.alphabetIndex[ch] == noIndex) {
+            return 0;
+        }
+    }
+
+    const size_t offset = tables.alphabetIndex[static_cast<unsigned char>(id[0])];
+    Working working(offset);
+
+    std::string_view slicedId(id.substr(1));
+    size_t count = 0;
+
+    while (!slicedId.empty()) {
+        const size_t end = slicedId.find(working.alphabet[0]);
+        const std::string_view chunk = slicedId.substr(0, end);
+        if (chunk.empty()) {
+            return count;
+        }
+
+        T number = 0;
+        if (!toNumber(chunk, working.index, number)) {
+            return 0;
+        }
+        if (count < capacity) {
+            numbers[count] = number;
+        }
+        count++;
+
+        if (end == std::string_view::npos) {
+            break;
+        }
+
+        working.shuffle(offset, true);
+        slicedId.remove_prefix(end + 1);
+    }
+
+    return count;
+}
+
+template<typename T, const char* Alphabet, uint8_t MinLength>
+bool StaticSqids<T, Alphabet, MinLength>::toNumber(std::string_view id, const uint8_t* index, T& number)
+{
+    constexpr T base = alphabetSize - 1;
+    T a = 0;
+
+    for (unsigned char ch : id) {
+        const T digit = index[ch] - 1;
+        if (a > (maxValue - digit) / base) {
+            return false;
+        }
+        a = a * base + digit;
+    }
+
+    number = a;
+    return true;
+}
+
+///
+/// Check that an ID is the canonical encoding of its numbers, see
+/// Sqids::isWellFormed().
+///
+template<typename T, const char* Alphabet, uint8_t MinLength>
+bool StaticSqids<T, Alphabet, MinLength>::isWellFormed(std::string_view id) const
+{
+    T numbers[wellFormedCapacity];
+    const size_t count = decodeInto(id, numbers, wellFormedCapacity);
+    if (count == 0 || id.size() > maxLength(count)) {
+        return false;
+    }
+
+    try {
+        if (count > wellFormedCapacity) {
+            return encode(decode(id)) == id;
+        }
+
+        char buffer[maxLength(wellFormedCapacity)];
+        const size_t length = encodeInto(numbers, count, buffer, sizeof(buffer));
+        return std::string_view(buffer, length) == id;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+} // namespace sqidscxx
@@ -12,6 +12,7 @@
 #include <userver/storages/postgres/component.hpp>
 #include <userver/utils/assert.hpp>
 #include <userver/clients/http/component.hpp>
+#include <userver/components/statistics_storage.hpp>
 
 
 #include <userver/clients/http/client.hpp>
@@ -27,7 +28,9 @@ RetryService::RetryService(const userver::components::ComponentConfig& config,
         m_dbHelper(
             component_context
                 .FindComponent<userver::components::Postgres>("postgres-db-1")
-                .GetCluster())
+                .GetCluster()),
+        m_retryPolicy(RetryPolicy::Settings{}, http_client_,
+            component_context.FindComponent<userver::components::StatisticsStorage>().GetStorage())
 {
   m_dbHelper.prepareDB(true);
 }  
@@ -81,11 +84,14 @@ std::string RetryService::GetValue(const userver::server::http::HttpRequest& req
   const auto longUrl = m_dbHelper.getLongUrl(token);
   if (!longUrl.empty())
   {
-    const auto responce = http_client_.CreateRequest()
-                              .get(longUrl)
-                              .headers(request.GetHeaders())
-                              .perform();
+    const auto retried = m_retryPolicy.fetch(longUrl, request.GetHeaders());
+    if (!retried.response)
+    {
+      request.SetResponseStatus(userver::server::http::HttpStatus::kBadGateway);
+      return std::string("request with url : ") + longUrl + " is failed: " + retried.error + "\n ";
+    }
 
+    const auto& responce = retried.response;
     request.SetResponseStatus(responce->status_code());
     if (responce.get())
     {
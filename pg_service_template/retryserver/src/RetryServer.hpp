@@ -6,6 +6,7 @@
 #include <userver/components/component_list.hpp>
 
 #include "../../src/db/DBHelper.hpp"
+#include "../../src/retry/RetryPolicy.hpp"
 
 #include <userver/clients/dns/component.hpp>
 #include <userver/components/component.hpp>
@@ -37,6 +38,7 @@ private:
   userver::clients::http::Client& http_client_;
 
   DBHelper m_dbHelper;
+  RetryPolicy m_retryPolicy;
 };
 
 void AppendRetryService(userver::components::ComponentList& component_list);
@@ -12,19 +12,451 @@
 #include <userver/storages/postgres/component.hpp>
 #include <userver/utils/assert.hpp>
 #include <userver/clients/http/component.hpp>
+#include <userver/components/statistics_storage.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
+#include <userver/formats/json.hpp>
+#include <userver/http/common_headers.hpp>
+#include <userver/utils/encoding/hex.hpp>
 
 #include "token_gen/TokenGenerator.hpp"
 
 #include <userver/clients/http/client.hpp>
+#include <userver/clients/http/error.hpp>
+#include <userver/clients/http/streamed_response.hpp>
+#include <userver/concurrent/queue.hpp>
+#include <userver/engine/deadline.hpp>
+#include <userver/engine/exception.hpp>
+#include <userver/logging/log.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
 
 #include "exceptions/DBException.hpp"
 #include "exceptions/InternalException.hpp"
-#include "ConfigParameters.hpp"
 
 namespace pg_service_template {
 
+namespace {
+
+sqidscxx::SqidsOptions makeSqidsOptions(const userver::yaml_config::YamlConfig& config)
+{
+  sqidscxx::SqidsOptions options;
+  options.alphabet = config["alphabet"].As<std::string>(options.alphabet);
+
+  const auto minLength = config["min-length"].As<int>(15);
+  if (minLength < 0 || minLength > std::numeric_limits<uint8_t>::max())
+  {
+    throw InternalLogicException("Token min-length must be between 0 and 255");
+  }
+  options.minLength = static_cast<uint8_t>(minLength);
+
+  if (!config["blocklist"].IsMissing())
+  {
+    const auto words = config["blocklist"].As<std::vector<std::string>>();
+    options.blocklist = std::set<std::string>(words.cbegin(), words.cend());
+  }
+  return options;
+}
+
+LinkStoreKey makeLinkStoreKey(const userver::yaml_config::YamlConfig& config)
+{
+  const auto key = config["linkstore-key"].As<std::string>("token");
+  if (key == "token")
+  {
+    return LinkStoreKey::token;
+  }
+  if (key == "id")
+  {
+    return LinkStoreKey::id;
+  }
+  throw InternalLogicException("linkstore-key must be either 'token' or 'id'");
+}
+
+LinkStorePartitioning makeLinkStorePartitioning(const userver::yaml_config::YamlConfig& config)
+{
+  const auto partitioning = config["linkstore-partitioning"].As<std::string>("none");
+  if (partitioning == "none")
+  {
+    return LinkStorePartitioning::none;
+  }
+  if (partitioning == "hourly")
+  {
+    return LinkStorePartitioning::hourly;
+  }
+  if (partitioning == "daily")
+  {
+    return LinkStorePartitioning::daily;
+  }
+  throw InternalLogicException("linkstore-partitioning must be either 'none', 'hourly' or 'daily'");
+}
+
+DBCleaner::Settings makeDBCleanerSettings(const userver::yaml_config::YamlConfig& config)
+{
+  DBCleaner::Settings settings;
+  settings.batchSize = config["batch-size"].As<std::size_t>(settings.batchSize);
+  settings.timeBudget = std::chrono::milliseconds{
+      config["time-budget-ms"].As<int64_t>(settings.timeBudget.count())};
+  return settings;
+}
+
+RetryPolicy::Settings makeRetrySettings(const userver::yaml_config::YamlConfig& config)
+{
+  RetryPolicy::Settings settings;
+  settings.attempts = config["attempts"].As<std::size_t>(settings.attempts);
+  settings.baseDelay = std::chrono::milliseconds{
+      config["base-delay-ms"].As<int64_t>(settings.baseDelay.count())};
+  settings.maxDelay = std::chrono::milliseconds{
+      config["max-delay-ms"].As<int64_t>(settings.maxDelay.count())};
+  settings.attemptTimeout = std::chrono::milliseconds{
+      config["attempt-timeout-ms"].As<int64_t>(settings.attemptTimeout.count())};
+  settings.deadline = std::chrono::milliseconds{
+      config["deadline-ms"].As<int64_t>(settings.deadline.count())};
+  return settings;
+}
+
+std::optional<TokenPool::Settings> makeTokenPoolSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto capacity = config["pool-size"].As<std::size_t>(0);
+  if (capacity == 0)
+  {
+    return std::nullopt;
+  }
+
+  TokenPool::Settings settings;
+  settings.capacity = capacity;
+  settings.lowWatermark = config["pool-low-watermark"].As<std::size_t>(capacity / 4);
+  settings.refillPeriod = std::chrono::milliseconds{
+      config["pool-refill-period-ms"].As<int64_t>(settings.refillPeriod.count())};
+  return settings;
+}
+
+// A JSON array of strings, or one item per line for any other content type
+std::vector<std::string> parseBatchLines(const userver::server::http::HttpRequest& request)
+{
+  std::vector<std::string> urls;
+  if (request.GetHeader(userver::http::headers::kContentType).rfind("application/json", 0) == 0)
+  {
+    const auto json = userver::formats::json::FromString(request.RequestBody());
+    urls.reserve(json.GetSize());
+    for (const auto& url : json)
+    {
+      urls.push_back(url.As<std::string>());
+    }
+    return urls;
+  }
+
+  std::istringstream lines(request.RequestBody());
+  std::string line;
+  while (std::getline(lines, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+    if (!line.empty())
+    {
+      urls.push_back(std::move(line));
+    }
+  }
+  return urls;
+}
+
+std::optional<RequestLogger::Settings> makeRequestLoggerSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto queueSize = config["queue-size"].As<std::size_t>(0);
+  if (queueSize == 0)
+  {
+    return std::nullopt;
+  }
+
+  RequestLogger::Settings settings;
+  settings.queueSize = queueSize;
+  settings.batchSize = config["batch-size"].As<std::size_t>(settings.batchSize);
+  settings.flushInterval = std::chrono::milliseconds{
+      config["flush-interval-ms"].As<int64_t>(settings.flushInterval.count())};
+  settings.blockTimeout = std::chrono::milliseconds{
+      config["block-timeout-ms"].As<int64_t>(settings.blockTimeout.count())};
+
+  const auto overflow = config["overflow"].As<std::string>("drop");
+  if (overflow == "block")
+  {
+    settings.overflowPolicy = RequestLogger::OverflowPolicy::block;
+  }
+  else if (overflow != "drop")
+  {
+    throw InternalLogicException("request-log overflow must be either 'drop' or 'block'");
+  }
+  return settings;
+}
+
+std::optional<LinkAccessRecorder::Settings> makeLinkAccessSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto flushInterval = config["flush-interval-ms"].As<int64_t>(0);
+  if (flushInterval == 0)
+  {
+    return std::nullopt;
+  }
+
+  LinkAccessRecorder::Settings settings;
+  settings.flushInterval = std::chrono::milliseconds{flushInterval};
+  settings.batchSize = config["batch-size"].As<std::size_t>(settings.batchSize);
+  settings.maxPending = config["max-pending"].As<std::size_t>(settings.maxPending);
+  return settings;
+}
+
+// proxy, or the status of the redirect: 301, 302 or 307
+ResponseMode parseResponseMode(const std::string& mode)
+{
+  if (mode == "proxy")
+  {
+    return ResponseMode::proxy;
+  }
+  if (mode == "301")
+  {
+    return ResponseMode::movedPermanently;
+  }
+  if (mode == "302")
+  {
+    return ResponseMode::found;
+  }
+  if (mode == "307")
+  {
+    return ResponseMode::temporaryRedirect;
+  }
+  throw std::invalid_argument("mode must be either 'proxy', '301', '302' or '307'");
+}
+
+ResponseMode makeResponseMode(const userver::yaml_config::YamlConfig& config)
+{
+  try
+  {
+    return parseResponseMode(config["response-mode"].As<std::string>("proxy"));
+  }
+  catch (const std::invalid_argument&)
+  {
+    throw InternalLogicException("response-mode must be either 'proxy', '301', '302' or '307'");
+  }
+}
+
+// Optional ttl (seconds), sliding (true or false) and mode arguments of PUT /v1/shorten
+LinkOptions parseLinkOptions(const userver::server::http::HttpRequest& request)
+{
+  LinkOptions options;
+  if (request.HasArg("ttl"))
+  {
+    const auto& ttl = request.GetArg("ttl");
+    int64_t seconds = 0;
+    const auto [end, error] = std::from_chars(ttl.data(), ttl.data() + ttl.size(), seconds);
+    if (error != std::errc{} || end != ttl.data() + ttl.size()
+      || seconds <= 0 || seconds > std::numeric_limits<int32_t>::max())
+    {
+      throw std::invalid_argument("ttl must be a positive number of seconds");
+    }
+    options.timeToLive = std::chrono::seconds(seconds);
+  }
+
+  if (request.HasArg("sliding"))
+  {
+    const auto& sliding = request.GetArg("sliding");
+    if (sliding == "true" || sliding == "1")
+    {
+      options.sliding = true;
+    }
+    else if (sliding != "false" && sliding != "0")
+    {
+      throw std::invalid_argument("sliding must be either 'true' or 'false'");
+    }
+  }
+
+  if (request.HasArg("mode"))
+  {
+    options.responseMode = parseResponseMode(request.GetArg("mode"));
+  }
+  return options;
+}
+
+void checkLongUrl(const std::string& url)
+{
+  // The url is sent back verbatim as the Location of redirects: only absolute
+  // http(s) urls are stored, and nothing that could split the header
+  const auto schemeEnd = url.find("://");
+  std::string scheme = url.substr(0, schemeEnd);
+  std::transform(scheme.begin(), scheme.end(), scheme.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (schemeEnd == std::string::npos || (scheme != "http" && scheme != "https")
+    || schemeEnd + 3 == url.size())
+  {
+    throw std::invalid_argument("url must be an absolute http or https url");
+  }
+  const auto control = std::find_if(url.begin(), url.end(), [](unsigned char c) {
+    return c <= 0x20 || c == 0x7f;
+  });
+  if (control != url.end())
+  {
+    throw std::invalid_argument("url must not contain spaces or control characters");
+  }
+}
+
+// Option given for an url already stored with another value of it
+std::optional<std::string> conflictingOption(const userver::server::http::HttpRequest& request,
+                                             const LinkOptions& options, const StoredLink& stored)
+{
+  if (request.HasArg("ttl")
+    && stored.ttlSeconds != std::optional<int32_t>{static_cast<int32_t>(options.timeToLive->count())})
+  {
+    return "ttl";
+  }
+  if (request.HasArg("sliding") && stored.sliding != options.sliding)
+  {
+    return "sliding";
+  }
+  if (request.HasArg("mode")
+    && stored.responseMode != std::optional<int16_t>{static_cast<int16_t>(options.responseMode.value())})
+  {
+    return "mode";
+  }
+  return std::nullopt;
+}
+
+std::optional<ShortLink::ProxyStreamSettings> makeProxyStreamSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto maxBufferBytes = config["max-buffer-bytes"].As<std::size_t>(0);
+  if (maxBufferBytes == 0)
+  {
+    return std::nullopt;
+  }
+
+  ShortLink::ProxyStreamSettings settings;
+  settings.maxBufferBytes = maxBufferBytes;
+  settings.timeout = std::chrono::milliseconds{
+      config["timeout-ms"].As<int64_t>(settings.timeout.count())};
+  settings.chunkTimeout = std::chrono::milliseconds{
+      config["chunk-timeout-ms"].As<int64_t>(settings.chunkTimeout.count())};
+  return settings;
+}
+
+std::optional<ResponseCache::Settings> makeResponseCacheSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto maxBytes = config["max-bytes"].As<std::size_t>(0);
+  if (maxBytes == 0)
+  {
+    return std::nullopt;
+  }
+
+  ResponseCache::Settings settings;
+  settings.maxBytes = maxBytes;
+  settings.maxEntryBytes = config["max-entry-bytes"].As<std::size_t>(settings.maxEntryBytes);
+  settings.shardsCount = config["shards"].As<std::size_t>(settings.shardsCount);
+  settings.maxVariants = config["max-variants"].As<std::size_t>(settings.maxVariants);
+  settings.revalidateTimeout = std::chrono::milliseconds{
+    config["revalidate-timeout-ms"].As<int64_t>(settings.revalidateTimeout.count())};
+  return settings;
+}
+
+// Conditional headers of the client are answered by the cache, the
+// upstream is only asked to revalidate the cached answer
+ResponseCache::HeaderMap makeRevalidationHeaders(const userver::server::http::HttpRequest& request,
+                                                 const ResponseCache::Response& cached)
+{
+  auto headers = request.GetHeaders();
+  headers.Erase(std::string{"If-None-Match"});
+  headers.Erase(std::string{"If-Modified-Since"});
+  ResponseCache::addValidators(cached, headers);
+  return headers;
+}
+
+// Upstream answers to credentialed requests may be personal, they are never
+// shared with the concurrent requests of other clients
+bool hasCredentials(const userver::server::http::HttpRequest& request)
+{
+  return request.HasHeader(userver::http::headers::kAuthorization)
+    || request.HasHeader(userver::http::headers::kCookie);
+}
+
+// Forwarded request headers the upstream picks the representation by
+const std::vector<std::string> kNegotiationHeaders{
+  "Accept", "Accept-Encoding", "Accept-Language", "Range", "If-Range", "If-None-Match", "If-Modified-Since"};
+
+// Concurrent requests of the url share an upstream call only when they would
+// get the same representation of it
+std::string upstreamFlightKey(const userver::server::http::HttpRequest& request, const std::string& url)
+{
+  std::string key = url;
+  for (const auto& name : kNegotiationHeaders)
+  {
+    key += '\n';
+    key += request.GetHeader(name);
+  }
+  return key;
+}
+
+// The same headers go with an answer whether it is fetched or read from the cache
+void setEndToEndHeaders(const userver::server::http::HttpRequest& request,
+                        const userver::http::headers::HeaderMap& upstreamHeaders)
+{
+  for (const auto& [name, value] : ResponseCache::endToEndHeaders(upstreamHeaders))
+  {
+    request.GetHttpResponse().SetHeader(name, value);
+  }
+}
+
+// Framing of the upstream connection, the server frames the streamed answer itself
+bool isHopByHopHeader(std::string name)
+{
+  static const std::set<std::string> hopByHop{
+    "connection", "keep-alive", "proxy-authenticate", "proxy-authorization",
+    "te", "trailer", "transfer-encoding", "upgrade", "content-length"};
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return hopByHop.count(name) != 0;
+}
+
+std::optional<LinkCacheSettings> makeLinkCacheSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto capacity = config["size"].As<std::size_t>(0);
+  if (capacity == 0)
+  {
+    return std::nullopt;
+  }
+
+  LinkCacheSettings settings;
+  settings.capacity = capacity;
+  settings.shardsCount = config["shards"].As<std::size_t>(settings.shardsCount);
+  settings.maxTimeToLive = std::chrono::milliseconds{
+      config["max-ttl-ms"].As<int64_t>(settings.maxTimeToLive.count())};
+  return settings;
+}
+
+std::optional<TokenFilter::Settings> makeTokenFilterSettings(const userver::yaml_config::YamlConfig& config)
+{
+  const auto expectedItems = config["expected-items"].As<std::size_t>(0);
+  if (expectedItems == 0)
+  {
+    return std::nullopt;
+  }
+
+  TokenFilter::Settings settings;
+  settings.expectedItems = expectedItems;
+  settings.falsePositiveRate = config["false-positive-rate"].As<double>(settings.falsePositiveRate);
+  settings.syncPeriod = std::chrono::milliseconds{
+      config["sync-period-ms"].As<int64_t>(settings.syncPeriod.count())};
+  settings.rebuildPeriod = std::chrono::seconds{
+      config["rebuild-period-s"].As<int64_t>(settings.rebuildPeriod.count())};
+  return settings;
+}
+
+}  // namespace
 
 ShortLink::ShortLink(const userver::components::ComponentConfig& config,
   const userver::components::ComponentContext& component_context)
@@ -33,11 +465,90 @@ ShortLink::ShortLink(const userver::components::ComponentConfig& config,
       m_dbHelper(
           component_context
                 .FindComponent<userver::components::Postgres>("postgres-db-1")
-                .GetCluster()),
-      m_dbCleaner(m_dbHelper)
+                .GetCluster(),
+          makeLinkStoreKey(config),
+          makeLinkStorePartitioning(config)),
+      m_dbCleaner(m_dbHelper, makeDBCleanerSettings(config["cleaner"]),
+                  component_context.FindComponent<userver::components::StatisticsStorage>().GetStorage()),
+      m_upstreamRetry(makeRetrySettings(config["upstream-retry"]), http_client_,
+                      component_context.FindComponent<userver::components::StatisticsStorage>().GetStorage()),
+      m_idGenerator(config["token-generator"]["id-block-size"].As<int64_t>(10000),
+                    [this](int64_t blockSize) { return m_dbHelper.leaseIdBlock(blockSize); }),
+      m_tokenGenerator(m_idGenerator, makeSqidsOptions(config["token-generator"])),
+      m_linkStoreCache(component_context.FindComponentOptional<LinkStoreCache>()),
+      m_batchMaxSize(config["batch-max-size"].As<std::size_t>(10000)),
+      m_responseMode(makeResponseMode(config)),
+      m_proxyStream(makeProxyStreamSettings(config["proxy-stream"]))
 {
+  if (m_proxyStream.has_value() && !config["response-body-stream"].As<bool>(false))
+  {
+    throw InternalLogicException("proxy-stream requires response-body-stream of the handler");
+  }
+
+  if (m_linkStoreCache != nullptr && m_linkStoreCache->keyMode() != m_dbHelper.keyMode())
+  {
+    throw InternalLogicException("linkstore-key of the linkstore cache differs from the handler one");
+  }
+
   m_dbHelper.prepareDB(true);
 
+  auto& statisticsStorage =
+      component_context.FindComponent<userver::components::StatisticsStorage>().GetStorage();
+
+  const auto poolSettings = makeTokenPoolSettings(config["token-generator"]);
+  if (poolSettings.has_value())
+  {
+    m_tokenGenerator.enablePool(poolSettings.value(), statisticsStorage);
+  }
+
+  const auto cacheSettings = makeLinkCacheSettings(config["link-cache"]);
+  if (cacheSettings.has_value())
+  {
+    m_linkCache = std::make_unique<LinkCache<LinkTarget>>(cacheSettings.value(), "link-cache", statisticsStorage);
+  }
+
+  const auto urlCacheSettings = makeLinkCacheSettings(config["url-cache"]);
+  if (urlCacheSettings.has_value())
+  {
+    m_urlCache = std::make_unique<LinkCache<std::string>>(urlCacheSettings.value(), "url-cache", statisticsStorage);
+  }
+
+  const auto responseCacheSettings = makeResponseCacheSettings(config["response-cache"]);
+  if (responseCacheSettings.has_value())
+  {
+    m_responseCache = std::make_unique<ResponseCache>(responseCacheSettings.value(), statisticsStorage);
+  }
+
+  const auto flightShards = config["single-flight"]["shards"].As<std::size_t>(0);
+  if (flightShards != 0)
+  {
+    m_lookupFlight = std::make_unique<SingleFlight<std::optional<LongUrlInfo>>>(
+        flightShards, "link-lookup-flight", statisticsStorage);
+    m_upstreamFlight = std::make_unique<SingleFlight<RetryPolicy::Result>>(
+        flightShards, "upstream-flight", statisticsStorage);
+  }
+
+  const auto requestLoggerSettings = makeRequestLoggerSettings(config["request-log"]);
+  if (requestLoggerSettings.has_value())
+  {
+    m_requestLogger = std::make_unique<RequestLogger>(requestLoggerSettings.value(), m_dbHelper, statisticsStorage);
+  }
+
+  const auto accessSettings = makeLinkAccessSettings(config["sliding-expiry"]);
+  if (accessSettings.has_value())
+  {
+    m_accessRecorder = std::make_unique<LinkAccessRecorder>(accessSettings.value(), m_dbHelper, statisticsStorage);
+  }
+
+  const auto filterSettings = makeTokenFilterSettings(config["token-filter"]);
+  if (filterSettings.has_value())
+  {
+    m_tokenFilter = std::make_unique<TokenFilter>(
+        filterSettings.value(), m_dbHelper,
+        [this](std::string_view token) { return m_tokenGenerator.decodeId(token); }, statisticsStorage);
+    m_tokenFilter->start();
+  }
+
   m_dbCleaner.start();
 }  
 
@@ -45,6 +556,30 @@ ShortLink::ShortLink(const userver::components::ComponentConfig& config,
 std::string ShortLink::HandleRequestThrow(
   const userver::server::http::HttpRequest& request,
   userver::server::request::RequestContext& ) const 
+{
+  return handleRequest(request, nullptr);
+}
+
+void ShortLink::HandleStreamRequest(
+  userver::server::http::HttpRequest& request,
+  userver::server::request::RequestContext& ,
+  userver::server::http::ResponseBodyStream& responseBody) const
+{
+  ProxyStream stream{responseBody};
+  auto body = handleRequest(request, &stream);
+  if (stream.started)
+  {
+    return;
+  }
+
+  // Everything but a proxied GET is answered at once
+  responseBody.SetStatusCode(request.GetHttpResponse().GetStatus());
+  responseBody.SetEndOfHeaders();
+  responseBody.PushBodyChunk(std::move(body), userver::engine::Deadline{});
+}
+
+std::string ShortLink::handleRequest(const userver::server::http::HttpRequest& request,
+                                     ProxyStream* stream) const
 {
   try
   {
@@ -53,12 +588,22 @@ std::string ShortLink::HandleRequestThrow(
     {
       case userver::server::http::HttpMethod::kGet:
       {
-        return GetValue(request);
+        return GetValue(request, stream);
       }
       case userver::server::http::HttpMethod::kDelete:
       {
         return DeleteValue(request);
       }
+      case userver::server::http::HttpMethod::kPost:
+      {
+        if (request.PathArgCount() == 2
+          && request.GetPathArg(1) == "resolve") // v1/resolve
+        {
+          return PostResolve(request);
+        }
+        request.SetResponseStatus(userver::server::http::HttpStatus::BadRequest);
+        return fmt::format("Unsupported method {}", request.GetMethod());
+      }
       case userver::server::http::HttpMethod::kPut:
       {
         if (request.PathArgCount() == 2 
@@ -66,6 +611,12 @@ std::string ShortLink::HandleRequestThrow(
         {
           return PutValue(request);
         }
+        if (request.PathArgCount() == 3
+          && request.GetPathArg(1) == "shorten"
+          && request.GetPathArg(2) == "batch") // v1/shorten/batch
+        {
+          return PutBatch(request);
+        }
       }
       default:
         request.SetResponseStatus(userver::server::http::HttpStatus::BadRequest);
@@ -93,21 +644,218 @@ std::string ShortLink::PutValue(const userver::server::http::HttpRequest& reques
 {    
   const auto& longUrl = request.RequestBody();
 
-  auto tokenExist = m_dbHelper.findToken(longUrl);
-  if (tokenExist.has_value()) 
+  LinkOptions options;
+  try
+  {
+    checkLongUrl(longUrl);
+    options = parseLinkOptions(request);
+  }
+  catch (const std::invalid_argument& e)
+  {
+    request.SetResponseStatus(userver::server::http::HttpStatus::BadRequest);
+    return std::string(e.what()) + "\n";
+  }
+  if (options.sliding && !m_accessRecorder)
+  {
+    request.SetResponseStatus(userver::server::http::HttpStatus::BadRequest);
+    return "Sliding expiry is disabled\n";
+  }
+
+  // Popular urls are submitted again and again: answer them from memory.
+  // The options of a cached url are unknown, explicit ones are checked by the database
+  const bool explicitOptions = request.HasArg("ttl") || request.HasArg("sliding") || request.HasArg("mode");
+  std::string digest;
+  if (m_urlCache)
+  {
+    digest = DBHelper::linkDigest(longUrl);
+    const auto cached = explicitOptions ? std::optional<std::string>{} : m_urlCache->get(digest);
+    if (cached.has_value())
+    {
+      request.SetResponseStatus(userver::server::http::HttpStatus::kFound);
+      return std::string{"url is already exists: http://localhost:8088/v1/shorten/" +
+                             cached.value() + "\n"};
+    }
+  }
+
+  const auto stored = shortenUrl(m_tokenGenerator.generateToken(), longUrl, options);
+  if (m_urlCache)
+  {
+    m_urlCache->put(digest, stored.token, std::nullopt);
+  }
+  if (!stored.inserted)
   {
+    const auto conflict = conflictingOption(request, options, stored);
+    if (conflict.has_value())
+    {
+      request.SetResponseStatus(userver::server::http::HttpStatus::kConflict);
+      return fmt::format("url is already shortened with another {}: http://localhost:8088/v1/shorten/{}\n",
+                         conflict.value(), stored.token);
+    }
     request.SetResponseStatus(userver::server::http::HttpStatus::kFound);
     return std::string{"url is already exists: http://localhost:8088/v1/shorten/" +
-                           tokenExist.value() + "\n"};
-  } 
-  else 
+                           stored.token + "\n"};
+  }
+  request.SetResponseStatus(userver::server::http::HttpStatus::kCreated);
+  return std::string{"generated url : http://localhost:8088/v1/shorten/" + stored.token +
+                         "\n"};
+}
+
+std::string ShortLink::PutBatch(const userver::server::http::HttpRequest& request) const
+{
+  std::vector<std::string> urls;
+  try
+  {
+    urls = parseBatchLines(request);
+  }
+  catch (const userver::formats::json::Exception& e)
   {
-    const auto token = TokenGenerator::generateToken();
-    m_dbHelper.saveTokenInfo(token, longUrl);
-    request.SetResponseStatus(userver::server::http::HttpStatus::kCreated);
-    return std::string{"generated url : http://localhost:8088/v1/shorten/" + token +
-                           "\n"};
-  }    
+    request.SetResponseStatus(userver::server::http::HttpStatus::kBadRequest);
+    return std::string("Batch must be a JSON array of urls: ") + e.what() + "\n";
+  }
+  if (urls.size() > m_batchMaxSize)
+  {
+    request.SetResponseStatus(userver::server::http::HttpStatus::kPayloadTooLarge);
+    return fmt::format("Batch is limited to {} urls\n", m_batchMaxSize);
+  }
+  for (std::size_t i = 0; i < urls.size(); ++i)
+  {
+    try
+    {
+      checkLongUrl(urls[i]);
+    }
+    catch (const std::invalid_argument& e)
+    {
+      request.SetResponseStatus(userver::server::http::HttpStatus::kBadRequest);
+      return fmt::format("Batch url {}: {}\n", i, e.what());
+    }
+  }
+
+  // Every distinct url is looked up and stored once, whatever its repeats
+  std::vector<std::string> digests;
+  digests.reserve(urls.size());
+  std::unordered_map<std::string, std::size_t> firstUrlOf;
+  std::vector<std::string> uniqueDigests;
+  for (std::size_t i = 0; i < urls.size(); ++i)
+  {
+    digests.push_back(userver::utils::encoding::ToHex(DBHelper::linkDigest(urls[i])));
+    if (firstUrlOf.emplace(digests.back(), i).second)
+    {
+      uniqueDigests.push_back(digests.back());
+    }
+  }
+
+  const bool byId = m_dbHelper.keyMode() == LinkStoreKey::id;
+  std::unordered_map<std::string, DigestLink> links;
+  for (auto& link : m_dbHelper.findLinks(uniqueDigests))
+  {
+    links.emplace(link.digest, std::move(link));
+  }
+
+  std::vector<std::string> newTokens;
+  std::vector<int64_t> newIds;
+  std::vector<std::string> newUrls;
+  std::vector<std::string> newDigests;
+  for (const auto& digest : uniqueDigests)
+  {
+    if (links.count(digest) != 0)
+    {
+      continue;
+    }
+    auto token = m_tokenGenerator.generateToken();
+    const auto id = m_tokenGenerator.decodeId(token);
+    if (!id.has_value())
+    {
+      throw InternalLogicException("Generated token does not decode to an id");
+    }
+    newTokens.push_back(std::move(token));
+    newIds.push_back(id.value());
+    newUrls.push_back(urls[firstUrlOf.at(digest)]);
+    newDigests.push_back(digest);
+  }
+
+  if (!newDigests.empty())
+  {
+    for (auto& link : m_dbHelper.shortenUrls(newTokens, newIds, newUrls, newDigests))
+    {
+      links.insert_or_assign(link.digest, std::move(link));
+    }
+  }
+
+  userver::formats::json::ValueBuilder result(userver::formats::common::Type::kArray);
+  for (std::size_t i = 0; i < urls.size(); ++i)
+  {
+    auto& link = links.at(digests[i]);
+    const bool created = link.inserted && firstUrlOf.at(digests[i]) == i;
+    if (byId && link.token.empty())
+    {
+      link.token = m_tokenGenerator.encodeId(link.id);
+    }
+    if (created && m_tokenFilter)
+    {
+      m_tokenFilter->add(link.token, byId ? link.id : m_tokenGenerator.decodeId(link.token).value_or(0));
+    }
+
+    userver::formats::json::ValueBuilder item;
+    item["url"] = urls[i];
+    item["token"] = link.token;
+    item["short_url"] = "http://localhost:8088/v1/shorten/" + link.token;
+    // Only the first occurrence of a url in the batch counts as created
+    item["created"] = created;
+    result.PushBack(std::move(item));
+  }
+
+  request.GetHttpResponse().SetContentType(userver::http::content_type::kApplicationJson);
+  request.SetResponseStatus(userver::server::http::HttpStatus::kOk);
+  return userver::formats::json::ToString(result.ExtractValue());
+}
+
+StoredLink ShortLink::shortenUrl(const std::string& token, const std::string& longUrl,
+                                 const LinkOptions& options) const
+{
+  const auto id = m_tokenGenerator.decodeId(token);
+  if (!id.has_value())
+  {
+    throw InternalLogicException("Generated token does not decode to an id");
+  }
+
+  auto stored = m_dbHelper.keyMode() == LinkStoreKey::id
+    ? m_dbHelper.shortenUrl(id.value(), longUrl, options)
+    : m_dbHelper.shortenUrl(token, longUrl, options);
+  if (!stored.inserted)
+  {
+    if (m_dbHelper.keyMode() == LinkStoreKey::id)
+    {
+      stored.token = m_tokenGenerator.encodeId(stored.id);
+    }
+    return stored;
+  }
+
+  if (m_tokenFilter)
+  {
+    m_tokenFilter->add(token, id.value());
+  }
+  stored.token = token;
+  stored.id = id.value();
+  return stored;
+}
+
+void ShortLink::saveRequestResult(
+  const std::string& token,
+  const std::string& longUrlFind,
+  const int request_timeout_second,
+  const int request_attempt,
+  const int request_code,
+  const std::string& error) const
+{
+  if (!m_requestLogger)
+  {
+    m_dbHelper.saveRequestResult(token, longUrlFind, request_timeout_second,
+      request_attempt, request_code, error);
+    return;
+  }
+
+  m_requestLogger->write(RequestLogEvent{std::chrono::system_clock::now(), token, longUrlFind,
+    request_timeout_second, request_attempt, request_code, error});
 }
 
 bool ShortLink::isFailRequestCode(const uint16_t code) const
@@ -115,80 +863,323 @@ bool ShortLink::isFailRequestCode(const uint16_t code) const
   return code > 200 || code >= 400;
 }
 
-std::string ShortLink::GetValue(const userver::server::http::HttpRequest& request) const
-{    
-  const auto paths = request.PathArgCount();
-  if (paths != 1)
+std::string ShortLink::answerUpstream(
+  const userver::server::http::HttpRequest& request,
+  const std::string& token,
+  const std::string& longUrlFind,
+  const RetryPolicy::Result& fetched) const
+{
+  const auto deadlineSeconds = static_cast<int>(
+    std::chrono::duration_cast<std::chrono::seconds>(m_upstreamRetry.settings().deadline).count());
+
+  if (!fetched.response)
+  {
+    request.SetResponseStatus(userver::server::http::HttpStatus::kBadGateway);
+    saveRequestResult(token, longUrlFind, deadlineSeconds, static_cast<int>(fetched.attempts),
+      request.GetHttpResponse().GetStatus(), fetched.error);
+    return "unknown result from long url : " + longUrlFind + ". Retry request result:'" + fetched.error + "' \n";
+  }
+
+  const auto status = fetched.response->status_code();
+  saveRequestResult(token, longUrlFind, deadlineSeconds, static_cast<int>(fetched.attempts), status,
+    isFailRequestCode(status) ? fetched.response->body() : "");
+
+  request.SetResponseStatus(status);
+  if (isFailRequestCode(status))
+  {            
+    return "unknown result from long url : " + longUrlFind + ". Retry request result:'" + fetched.response->body() + "' \n";
+  }
+  setEndToEndHeaders(request, fetched.response->headers());
+  return fetched.response->body();
+}
+
+std::string ShortLink::streamLongUrl(
+  const userver::server::http::HttpRequest& request,
+  const std::string& token,
+  const std::string& longUrlFind,
+  ProxyStream& stream) const
+{
+  const auto& settings = m_proxyStream.value();
+  // Bounded by bytes, a full queue pauses the upstream transfer until the client catches up
+  const auto queue = userver::concurrent::StringStreamQueue::Create(settings.maxBufferBytes);
+  std::optional<userver::clients::http::StreamedResponse> responce;
+  userver::server::http::HttpStatus status{};
+  bool retry = false;
+  try
+  {
+    responce.emplace(http_client_.CreateRequest()
+      .get(longUrlFind)
+      .timeout(settings.timeout)
+      .headers(request.GetHeaders())
+      .async_perform_stream_body(queue));
+    status = responce->StatusCode();
+    retry = RetryPolicy::isRetryableStatus(static_cast<int>(status));
+  }
+  catch (const userver::clients::http::TimeoutException&)
+  {
+    retry = true;
+  }
+  catch (const userver::clients::http::NetworkProblemException&)
+  {
+    retry = true;
+  }
+  if (retry)
+  {
+    // Nothing is sent yet, the retried answer is sent at once. The streamed
+    // attempt counts against the limit
+    return answerUpstream(request, token, longUrlFind,
+      m_upstreamRetry.fetch(longUrlFind, request.GetHeaders(), 1));
+  }
+
+  // A copy is kept for the response cache while the body fits an entry, and
+  // never beyond the buffer a streamed request is allowed to hold
+  bool caching = m_responseCache && status == userver::server::http::HttpStatus::kOk
+    && ResponseCache::isStorable(request.GetHeaders(), responce->GetHeaders());
+  const auto cachedLimit = caching
+    ? std::min(m_responseCache->maxEntryBytes(), settings.maxBufferBytes) : 0;
+  std::string cached;
+
+  stream.body.SetStatusCode(status);
+  for (const auto& [name, value] : responce->GetHeaders())
+  {
+    if (!isHopByHopHeader(name))
+    {
+      stream.body.SetHeader(name, value);
+    }
+  }
+  stream.body.SetEndOfHeaders();
+  stream.started = true;
+
+  try
+  {
+    std::string chunk;
+    while (responce->ReadChunk(chunk, userver::engine::Deadline::FromDuration(settings.chunkTimeout)))
+    {
+      if (caching && cached.size() + chunk.size() <= cachedLimit)
+      {
+        cached += chunk;
+      }
+      else if (caching)
+      {
+        caching = false;
+        cached = std::string{};
+      }
+      stream.body.PushBodyChunk(std::move(chunk), userver::engine::Deadline::FromDuration(settings.chunkTimeout));
+      chunk.clear();
+    }
+  }
+  catch (const std::exception& e)
+  {
+    // The status is already sent, the client gets a truncated body
+    LOG_WARNING() << "Streaming of " << longUrlFind << " was interrupted: " << e.what();
+    saveRequestResult(token, longUrlFind, 0, 1, static_cast<int>(status), e.what());
+    return "";
+  }
+
+  if (caching)
   {
-    return request.GetHttpResponse().GetData();
+    m_responseCache->put(longUrlFind, request.GetHeaders(), responce->GetHeaders(), std::move(cached));
   }
+  saveRequestResult(token, longUrlFind, 0, 1, static_cast<int>(status), "");
+  return "";
+}
 
-  if (request.PathArgCount() == 2 
-    && request.GetPathArg(1) == "shorten") // v1/shorten
+std::string ShortLink::streamLongUrlOnce(
+  const userver::server::http::HttpRequest& request,
+  const std::string& token,
+  const std::string& longUrlFind,
+  ProxyStream& stream) const
+{
+  // A streamed body can not be handed to the waiters, they are answered
+  // from the response cache the first GET fills instead
+  bool led = false;
+  std::string body;
+  try
+  {
+    m_upstreamFlight->run("stream:" + upstreamFlightKey(request, longUrlFind), [&] {
+      led = true;
+      body = streamLongUrl(request, token, longUrlFind, stream);
+      return RetryPolicy::Result{};
+    });
+  }
+  catch (const userver::engine::WaitInterruptedException&)
+  {
+    throw;
+  }
+  catch (const std::exception& e)
   {
-    const auto token = request.GetPathArg(0);
-    const auto longUrlFind = m_dbHelper.getLongUrl(token);
-    if (!longUrlFind.empty())
+    if (led)
+    {
+      throw;
+    }
+    LOG_WARNING() << "Shared streaming of " << longUrlFind << " failed: " << e.what();
+  }
+  if (led)
+  {
+    return body;
+  }
+
+  auto cached = findCachedResponse(request, token, longUrlFind);
+  if (cached.has_value())
+  {
+    return std::move(cached.value());
+  }
+  // Not storable or too large: every GET streams its own copy
+  return streamLongUrl(request, token, longUrlFind, stream);
+}
+
+std::optional<std::string> ShortLink::findCachedResponse(
+  const userver::server::http::HttpRequest& request,
+  const std::string& token,
+  const std::string& longUrlFind) const
+{
+  const auto lookup = m_responseCache->get(longUrlFind, request.GetHeaders());
+  if (!lookup.response)
+  {
+    return std::nullopt;
+  }
+
+  if (!lookup.fresh)
+  {
+    const auto revalidate = [&] {
+      RetryPolicy::Result revalidation;
+      revalidation.attempts = 1;
+      try
+      {
+        revalidation.response = http_client_.CreateRequest()
+          .get(longUrlFind)
+          .timeout(m_responseCache->revalidateTimeout())
+          .headers(makeRevalidationHeaders(request, *lookup.response))
+          .perform();
+      }
+      catch (const userver::clients::http::TimeoutException& e)
+      {
+        revalidation.error = e.what();
+        return revalidation;
+      }
+      catch (const userver::clients::http::NetworkProblemException& e)
+      {
+        revalidation.error = e.what();
+        return revalidation;
+      }
+
+      const auto& fetched = revalidation.response;
+      if (fetched->status_code() == userver::server::http::HttpStatus::kOk)
+      {
+        m_responseCache->put(longUrlFind, request.GetHeaders(), fetched->headers(), fetched->body());
+      }
+      else if (fetched->status_code() == userver::server::http::HttpStatus::kNotModified)
+      {
+        m_responseCache->revalidated(longUrlFind, request.GetHeaders(), fetched->headers());
+      }
+      return revalidation;
+    };
+    // Conditional requests are coalesced apart from the plain fetches of the url
+    const auto revalidation = m_upstreamFlight && !hasCredentials(request)
+      ? m_upstreamFlight->run("revalidate:" + upstreamFlightKey(request, longUrlFind), revalidate)
+      : revalidate();
+    const auto& responce = revalidation.response;
+    if (responce && responce->status_code() == userver::server::http::HttpStatus::kOk)
     {
-      const auto responce = http_client_.CreateRequest()
-        .get(longUrlFind)
-        .timeout(std::chrono::seconds(1))
-        .headers(request.GetHeaders())
-        .perform();
       request.SetResponseStatus(responce->status_code());
-      if (responce.get())
+      setEndToEndHeaders(request, responce->headers());
+      saveRequestResult(token, longUrlFind, 0, 1, responce->status_code(), "");
+      return responce->body();
+    }
+    if (!responce || responce->status_code() != userver::server::http::HttpStatus::kNotModified)
+    {
+      // Failures take the usual proxy path with its retry
+      return std::nullopt;
+    }
+  }
+
+  for (const auto& [name, value] : lookup.response->headers)
+  {
+    request.GetHttpResponse().SetHeader(name, value);
+  }
+  request.SetResponseStatus(userver::server::http::HttpStatus::kOk);
+  saveRequestResult(token, longUrlFind, 0, 0, 200, "");
+  return lookup.response->body;
+}
+
+std::string ShortLink::GetValue(const userver::server::http::HttpRequest& request, ProxyStream* stream) const
+{    
+  if (request.PathArgCount() == 3 
+    && request.GetPathArg(1) == "shorten") // v1/shorten/<token>
+  {
+    const auto token = request.GetPathArg(2);
+    const auto id = m_tokenGenerator.decodeId(token);
+    if (!id.has_value()
+      || (m_tokenFilter && !m_tokenFilter->mayContain(token, id.value())))
+    {
+      request.SetResponseStatus(userver::server::http::HttpStatus::NotFound);
+      return "A short url was expired or unknown\n";
+    }
+
+    const auto link = findLink(token, id.value());
+    if (link.has_value())
+    {
+      const auto& longUrlFind = link->longUrl;
+      // Which links slide is only known to the database, it skips the rest
+      if (m_accessRecorder)
       {
-        if (isFailRequestCode(responce->status_code()))
-        {
-          const auto request_wait_timeout 
-            = std::atoi(m_dbHelper.getSettingValue(ConfigParametersMap.at(ConfigParametersEnum::request_wait_timeout)).c_str());
-
-          const auto request_retry_attempt
-            = std::atoi(m_dbHelper.getSettingValue(ConfigParametersMap.at(ConfigParametersEnum::request_try_attempt)).c_str());
-
-          const auto responceRetry = http_client_.CreateRequest()
-            .get("http://localhost:8089/v1/retry/" + token)
-            .timeout(std::chrono::seconds(request_wait_timeout * 1000))
-            .retry(request_retry_attempt)
-            .headers(request.GetHeaders())
-            .perform();
-
-            
-          m_dbHelper.saveRequestResult(token, longUrlFind, request_wait_timeout, 
-            request_retry_attempt, responceRetry->status_code(),
-            isFailRequestCode(responceRetry->status_code()) ? responceRetry->body() : "");
-          
-          request.SetResponseStatus(responceRetry->status_code());
-          if (isFailRequestCode(responceRetry->status_code()))
-          {            
-            return "unknown result from long url : " + longUrlFind + ". Retry request result:'" + responceRetry->body() + "' \n";
-          }
-          else
-          {
-            responceRetry->body();
-          }
-        }
-        else
+        m_accessRecorder->record(token, id.value());
+      }
+
+      // A redirect sends the client to the long url itself, no upstream call
+      const auto mode = link->responseMode.value_or(m_responseMode);
+      if (mode != ResponseMode::proxy)
+      {
+        const auto status = static_cast<int>(mode);
+        request.SetResponseStatus(static_cast<userver::server::http::HttpStatus>(status));
+        request.GetHttpResponse().SetHeader(userver::http::headers::kLocation, longUrlFind);
+        saveRequestResult(token, longUrlFind, 0, 0, status, "");
+        return "";
+      }
+
+      if (m_responseCache)
+      {
+        auto cached = findCachedResponse(request, token, longUrlFind);
+        if (cached.has_value())
         {
-          m_dbHelper.saveRequestResult(token, longUrlFind, 0, 1, responce->status_code(),
-            isFailRequestCode(responce->status_code()) ? responce->body() : "");
+          return std::move(cached.value());
         }
-        return responce->body();
       }
-      else
+
+      if (stream != nullptr && m_proxyStream.has_value())
       {
-        request.SetResponseStatus(userver::server::http::HttpStatus::NotFound);
-        m_dbHelper.saveRequestResult(token, longUrlFind, 0, 1, 
-         request.GetHttpResponse().GetStatus(), responce->body());
-        return "undefined result";
-      }        
+        return m_upstreamFlight && m_responseCache && !hasCredentials(request)
+          ? streamLongUrlOnce(request, token, longUrlFind, *stream)
+          : streamLongUrl(request, token, longUrlFind, *stream);
+      }
+
+      // Every attempt goes through the retry policy, only the first of
+      // concurrent GETs of the url stores the answer
+      const auto fetch = [&] {
+        auto fetched = m_upstreamRetry.fetch(longUrlFind, request.GetHeaders());
+        if (m_responseCache && fetched.response
+          && fetched.response->status_code() == userver::server::http::HttpStatus::kOk)
+        {
+          m_responseCache->put(longUrlFind, request.GetHeaders(), fetched.response->headers(),
+                               fetched.response->body());
+        }
+        return fetched;
+      };
+      const auto fetched = m_upstreamFlight && !hasCredentials(request)
+        ? m_upstreamFlight->run(upstreamFlightKey(request, longUrlFind), fetch)
+        : fetch();
+      return answerUpstream(request, token, longUrlFind, fetched);
     }
     else
     {
+      if (m_tokenFilter)
+      {
+        m_tokenFilter->reportFalsePositive();
+      }
       const std::string error = "A short url was expired or unknown\n";
       request.SetResponseStatus(
         userver::server::http::HttpStatus::NotFound);
-      m_dbHelper.saveRequestResult(token, "not found long url", 0, 1, 
+      saveRequestResult(token, "not found long url", 0, 1, 
         request.GetHttpResponse().GetStatus(), error);
       return error;
     }
@@ -198,23 +1189,436 @@ std::string ShortLink::GetValue(const userver::server::http::HttpRequest& reques
 }
 
 
+std::optional<LinkTarget> ShortLink::findCachedLink(const std::string& token, const int64_t id) const
+{
+  if (m_linkStoreCache != nullptr)
+  {
+    // Links created after the last cache update are still read from postgres
+    auto loaded = m_linkStoreCache->getLink(token, id);
+    if (loaded.has_value())
+    {
+      return loaded;
+    }
+  }
+
+  if (m_linkCache)
+  {
+    return m_linkCache->get(token);
+  }
+  return std::nullopt;
+}
+
+std::optional<LinkTarget> ShortLink::findLink(const std::string& token, const int64_t id) const
+{
+  auto cached = findCachedLink(token, id);
+  if (cached.has_value())
+  {
+    return cached;
+  }
+
+  const auto lookup = [this, &token, id] {
+    return m_dbHelper.keyMode() == LinkStoreKey::id
+      ? m_dbHelper.getLongUrlInfo(id)
+      : m_dbHelper.getLongUrlInfo(token);
+  };
+  const auto info = m_lookupFlight ? m_lookupFlight->run(token, lookup) : lookup();
+  if (!info.has_value())
+  {
+    return std::nullopt;
+  }
+
+  LinkTarget target{info->longUrl, info->responseMode};
+  if (m_linkCache)
+  {
+    m_linkCache->put(token, target, info->timeToLive);
+  }
+  return target;
+}
+
+std::string ShortLink::PostResolve(const userver::server::http::HttpRequest& request) const
+{
+  std::vector<std::string> tokens;
+  try
+  {
+    tokens = parseBatchLines(request);
+  }
+  catch (const userver::formats::json::Exception& e)
+  {
+    request.SetResponseStatus(userver::server::http::HttpStatus::kBadRequest);
+    return std::string("Tokens must be a JSON array of strings: ") + e.what() + "\n";
+  }
+  if (tokens.size() > m_batchMaxSize)
+  {
+    request.SetResponseStatus(userver::server::http::HttpStatus::kPayloadTooLarge);
+    return fmt::format("Resolve is limited to {} tokens\n", m_batchMaxSize);
+  }
+
+  // Unknown, expired and malformed tokens stay null
+  userver::formats::json::ValueBuilder result(userver::formats::common::Type::kObject);
+  std::vector<std::string> missingTokens;
+  std::unordered_map<int64_t, std::string> missingIds;
+  for (const auto& token : tokens)
+  {
+    if (result.HasMember(token))
+    {
+      continue;
+    }
+    result[token] = userver::formats::json::ValueBuilder{};
+
+    const auto id = m_tokenGenerator.decodeId(token);
+    if (!id.has_value() || (m_tokenFilter && !m_tokenFilter->mayContain(token, id.value())))
+    {
+      continue;
+    }
+
+    const auto cached = findCachedLink(token, id.value());
+    if (cached.has_value())
+    {
+      result[token] = cached->longUrl;
+      continue;
+    }
+    missingTokens.push_back(token);
+    missingIds.emplace(id.value(), token);
+  }
+
+  if (!missingTokens.empty())
+  {
+    const bool byId = m_dbHelper.keyMode() == LinkStoreKey::id;
+    std::vector<int64_t> ids;
+    if (byId)
+    {
+      ids.reserve(missingIds.size());
+      for (const auto& [id, token] : missingIds)
+      {
+        ids.push_back(id);
+      }
+    }
+
+    const auto links = byId
+      ? m_dbHelper.getLongUrlInfos(ids)
+      : m_dbHelper.getLongUrlInfos(missingTokens);
+    for (const auto& link : links)
+    {
+      const auto& token = byId ? missingIds.at(link.id) : link.token;
+      if (m_linkCache)
+      {
+        m_linkCache->put(token, LinkTarget{link.info.longUrl, link.info.responseMode}, link.info.timeToLive);
+      }
+      result[token] = link.info.longUrl;
+    }
+
+    if (m_tokenFilter)
+    {
+      for (std::size_t i = links.size(); i < missingTokens.size(); ++i)
+      {
+        m_tokenFilter->reportFalsePositive();
+      }
+    }
+  }
+
+  request.GetHttpResponse().SetContentType(userver::http::content_type::kApplicationJson);
+  request.SetResponseStatus(userver::server::http::HttpStatus::kOk);
+  return userver::formats::json::ToString(result.ExtractValue());
+}
+
 std::string ShortLink::DeleteValue(const userver::server::http::HttpRequest& request) const
 {
-  if (request.HasPathArg(0))
+  if (request.PathArgCount() == 3
+    && request.GetPathArg(1) == "shorten") // v1/shorten/<token>
   {
-    const auto token = request.GetPathArg(0);
-    m_dbHelper.deleteLongUrlInfo(token);
+    const auto token = request.GetPathArg(2);
+    std::optional<std::string> digest;
+    if (m_dbHelper.keyMode() == LinkStoreKey::id)
+    {
+      const auto id = m_tokenGenerator.decodeId(token);
+      if (id.has_value())
+      {
+        digest = m_dbHelper.deleteLongUrlInfo(id.value());
+      }
+    }
+    else
+    {
+      digest = m_dbHelper.deleteLongUrlInfo(token);
+    }
+    // Dropped after the row is gone, so a concurrent request cannot cache it again
+    if (m_linkCache)
+    {
+      m_linkCache->erase(token);
+    }
+    if (m_urlCache && digest.has_value())
+    {
+      m_urlCache->erase(digest.value());
+    }
     request.SetResponseStatus(userver::server::http::HttpStatus::kAccepted);
     return "";
       
   }
 
-  return "unknown url for delete request";
   request.SetResponseStatus(userver::server::http::HttpStatus::BadRequest);
+  return "unknown url for delete request";
+}
+
+userver::yaml_config::Schema ShortLink::GetStaticConfigSchema()
+{
+  return userver::yaml_config::MergeSchemas<userver::server::handlers::HttpHandlerBase>(R"(
+type: object
+description: url shortener handler. PUT /v1/shorten of an url already stored answers 302 with its short url, or 409 when the ttl, sliding or mode given differ from those of the stored link; an expired link not deleted yet takes the new ones
+additionalProperties: false
+properties:
+    linkstore-key:
+        type: string
+        description: primary key of the linkstore table, 'token' text or the numeric 'id' encoded in the token
+        enum:
+          - token
+          - id
+    cleaner:
+        type: object
+        description: deletion of the expired links
+        additionalProperties: false
+        properties:
+            batch-size:
+                type: integer
+                description: rows deleted per statement
+                minimum: 1
+            time-budget-ms:
+                type: integer
+                description: a run stops deleting after it, the rest is left to the next run
+    linkstore-partitioning:
+        type: string
+        description: range partitioning of linkstore by creation time, expired partitions are dropped as a whole
+        enum:
+          - none
+          - hourly
+          - daily
+    proxy-stream:
+        type: object
+        description: proxied GETs forward the upstream body in chunks as it arrives, needs response-body-stream of the handler
+        additionalProperties: false
+        properties:
+            max-buffer-bytes:
+                type: integer
+                description: upstream bytes buffered per request before the transfer pauses, 0 buffers whole bodies instead
+                minimum: 0
+            timeout-ms:
+                type: integer
+                description: longest upstream transfer
+                minimum: 1
+            chunk-timeout-ms:
+                type: integer
+                description: longest wait for an upstream chunk or for the client to take one
+                minimum: 1
+    single-flight:
+        type: object
+        description: concurrent GETs of one token share the database lookup, of one long url and representation (Accept, Accept-Encoding, Accept-Language, Range and conditionals) the upstream fetch, unless the request carries Cookie or Authorization. Streamed GETs wait for the first one to fill the response cache
+        additionalProperties: false
+        properties:
+            shards:
+                type: integer
+                description: number of independently locked parts of the in-flight calls, 0 disables coalescing
+                minimum: 0
+    response-cache:
+        type: object
+        description: shared in-process HTTP cache of the upstream answers of proxied links
+        additionalProperties: false
+        properties:
+            max-bytes:
+                type: integer
+                description: bytes of cached answers, least recently used urls are evicted beyond it, 0 disables the cache
+                minimum: 0
+            max-entry-bytes:
+                type: integer
+                description: larger answers are never cached, streamed ones above proxy-stream.max-buffer-bytes neither
+                minimum: 1
+            shards:
+                type: integer
+                description: number of independently locked parts of the cache, each owns an equal part of max-bytes
+                minimum: 1
+            max-variants:
+                type: integer
+                description: answers kept per url for different values of the request headers named in Vary
+                minimum: 1
+            revalidate-timeout-ms:
+                type: integer
+                description: timeout of the conditional request revalidating a stale answer
+                minimum: 1
+    response-mode:
+        type: string
+        description: how GET answers for links created without a mode, 'proxy' returns the body of the long url, '301', '302' and '307' redirect to it
+        enum:
+          - proxy
+          - '301'
+          - '302'
+          - '307'
+    sliding-expiry:
+        type: object
+        description: batched expiry extension of the links created with sliding=true
+        additionalProperties: false
+        properties:
+            flush-interval-ms:
+                type: integer
+                description: period of the batched updates, 0 disables sliding expiry
+                minimum: 0
+            batch-size:
+                type: integer
+                description: links per update statement
+                minimum: 1
+            max-pending:
+                type: integer
+                description: distinct links accessed between flushes kept in memory, further ones are not extended
+                minimum: 1
+    link-cache:
+        type: object
+        description: in-process cache of token to long url used by redirects
+        additionalProperties: false
+        properties:
+            size:
+                type: integer
+                description: maximal number of cached links, 0 disables the cache
+                minimum: 0
+            shards:
+                type: integer
+                description: number of independently locked parts of the cache
+                minimum: 1
+            max-ttl-ms:
+                type: integer
+                description: upper bound of an entry lifetime, links expiring earlier in the database leave the cache earlier
+                minimum: 1
+    batch-max-size:
+        type: integer
+        description: most urls of one PUT /v1/shorten/batch and tokens of one POST /v1/resolve request
+        minimum: 1
+    request-log:
+        type: object
+        description: asynchronous batched writes of the request results into linkstorelogger
+        additionalProperties: false
+        properties:
+            queue-size:
+                type: integer
+                description: most events waiting to be written, 0 writes every event synchronously
+                minimum: 0
+            batch-size:
+                type: integer
+                description: most events inserted by one statement
+                minimum: 1
+            flush-interval-ms:
+                type: integer
+                description: longest time an event waits for its batch to fill up
+                minimum: 1
+            overflow:
+                type: string
+                description: what a request does when the queue is full, drop the event or wait for room
+                enum:
+                  - drop
+                  - block
+            block-timeout-ms:
+                type: integer
+                description: longest wait for room in the queue, the event is dropped after it
+                minimum: 1
+    upstream-retry:
+        type: object
+        description: in-process retries of proxied GETs failing with a timeout, a network error or a retryable status
+        additionalProperties: false
+        properties:
+            attempts:
+                type: integer
+                description: upstream requests per GET, the first one included
+                minimum: 1
+            base-delay-ms:
+                type: integer
+                description: backoff before the first retry, doubled for each next one and jittered
+                minimum: 0
+            max-delay-ms:
+                type: integer
+                description: longest backoff between two attempts
+                minimum: 0
+            attempt-timeout-ms:
+                type: integer
+                description: timeout of a single retried request
+                minimum: 1
+            deadline-ms:
+                type: integer
+                description: time all retries of a GET share, cut to the deadline of the incoming request
+                minimum: 1
+    url-cache:
+        type: object
+        description: in-process cache of long url digest to token used to deduplicate PUT requests
+        additionalProperties: false
+        properties:
+            size:
+                type: integer
+                description: maximal number of cached urls, 0 disables the cache
+                minimum: 0
+            shards:
+                type: integer
+                description: number of independently locked parts of the cache
+                minimum: 1
+            max-ttl-ms:
+                type: integer
+                description: lifetime of an entry, a token of a link expired in the database is returned at most that long
+                minimum: 1
+    token-filter:
+        type: object
+        description: bloom filter of existing links, GET answers 404 without a database query when it rejects a token
+        additionalProperties: false
+        properties:
+            expected-items:
+                type: integer
+                description: number of links the filter is sized for, 0 disables the filter
+                minimum: 0
+            false-positive-rate:
+                type: number
+                description: share of unknown tokens the filter is allowed to let through
+                minimum: 0
+                maximum: 1
+            sync-period-ms:
+                type: integer
+                description: how often links created by other instances are added
+                minimum: 1
+            rebuild-period-s:
+                type: integer
+                description: how often the filter is rebuilt to forget deleted and expired links
+                minimum: 1
+    token-generator:
+        type: object
+        description: options of the Sqids encoder used to generate tokens
+        additionalProperties: false
+        properties:
+            alphabet:
+                type: string
+                description: characters used in tokens
+            min-length:
+                type: integer
+                description: minimal length of generated tokens
+                minimum: 0
+                maximum: 255
+            id-block-size:
+                type: integer
+                description: how many ids are leased from the database at once
+                minimum: 1
+            pool-size:
+                type: integer
+                description: capacity of the pool of pre-generated tokens, 0 disables the pool
+                minimum: 0
+            pool-low-watermark:
+                type: integer
+                description: the pool is refilled when fewer tokens are left, a quarter of pool-size by default
+                minimum: 0
+            pool-refill-period-ms:
+                type: integer
+                description: how often the pool depth is checked by the refill task
+                minimum: 1
+            blocklist:
+                type: array
+                description: words that must never appear in tokens, built-in list when missing
+                items:
+                    type: string
+                    description: blocked word
+)");
 }
 
 void AppendShortLink(userver::components::ComponentList& component_list) {
   component_list.Append<ShortLink>();
+  component_list.Append<LinkStoreCache>();
   component_list.Append<userver::components::Postgres>("postgres-db-1");
   component_list.Append<userver::clients::dns::Component>();
   component_list.Append<userver::components::HttpClient>();  
@@ -6,6 +6,15 @@
 #include <userver/components/component_list.hpp>
 #include "db/DBHelper.hpp"
 #include "db/DBCleaner.hpp"
+#include "db/RequestLogger.hpp"
+#include "db/LinkAccessRecorder.hpp"
+#include "token_gen/TokenGenerator.hpp"
+#include "cache/LinkCache.hpp"
+#include "cache/LinkStoreCache.hpp"
+#include "cache/ResponseCache.hpp"
+#include "cache/SingleFlight.hpp"
+#include "retry/RetryPolicy.hpp"
+#include "cache/TokenFilter.hpp"
 
 #include <fmt/format.h>
 
@@ -18,7 +27,13 @@
 #include <userver/clients/http/component.hpp>
 
 #include <userver/clients/http/client.hpp>
+#include <userver/server/http/http_response_body_stream.hpp>
+#include <userver/yaml_config/schema.hpp>
 
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
 #include <string>
 
 namespace pg_service_template {
@@ -35,18 +50,109 @@ public:
       const userver::server::http::HttpRequest& request,
       userver::server::request::RequestContext& ) const override;
 
+  // Used instead of HandleRequestThrow when response-body-stream is set
+  void HandleStreamRequest(
+      userver::server::http::HttpRequest& request,
+      userver::server::request::RequestContext& context,
+      userver::server::http::ResponseBodyStream& responseBody) const override;
+
+  static userver::yaml_config::Schema GetStaticConfigSchema();
+
   userver::storages::postgres::ClusterPtr pg_cluster_;
+  struct ProxyStreamSettings
+  {
+    // Upstream bytes buffered per request before reading from it pauses
+    std::size_t maxBufferBytes = 1 << 20;
+    // Whole upstream transfer
+    std::chrono::milliseconds timeout{10000};
+    // Wait for a single chunk from the upstream or room for it in the client connection
+    std::chrono::milliseconds chunkTimeout{1000};
+  };
+
 private:
+  // Body stream of a streaming request, a proxied GET writes to it directly
+  struct ProxyStream
+  {
+    userver::server::http::ResponseBodyStream& body;
+    bool started = false;
+  };
+
+  std::string handleRequest(const userver::server::http::HttpRequest& request, ProxyStream* stream) const;
   std::string PutValue(const userver::server::http::HttpRequest& request) const;
-  std::string GetValue(const userver::server::http::HttpRequest& request) const;
+  std::string PutBatch(const userver::server::http::HttpRequest& request) const;
+  std::string PostResolve(const userver::server::http::HttpRequest& request) const;
+  std::string GetValue(const userver::server::http::HttpRequest& request, ProxyStream* stream) const;
   std::string DeleteValue(const userver::server::http::HttpRequest& request) const;
 
   bool isFailRequestCode(const uint16_t code) const;
 
+  // Sets the status of the last upstream answer and returns its body, or
+  // the error when every attempt of the retry policy failed
+  std::string answerUpstream(
+      const userver::server::http::HttpRequest& request,
+      const std::string& token,
+      const std::string& longUrlFind,
+      const RetryPolicy::Result& fetched) const;
+
+  // Answers from the response cache, a stale answer is revalidated with the
+  // upstream first, std::nullopt when the upstream body has to be fetched
+  std::optional<std::string> findCachedResponse(
+      const userver::server::http::HttpRequest& request,
+      const std::string& token,
+      const std::string& longUrlFind) const;
+
+  // Forwards the upstream status, headers and body chunks as they arrive
+  std::string streamLongUrl(
+      const userver::server::http::HttpRequest& request,
+      const std::string& token,
+      const std::string& longUrlFind,
+      ProxyStream& stream) const;
+
+  // Streams the url for the first of concurrent GETs, the rest wait for it
+  // and are answered from the response cache it fills
+  std::string streamLongUrlOnce(
+      const userver::server::http::HttpRequest& request,
+      const std::string& token,
+      const std::string& longUrlFind,
+      ProxyStream& stream) const;
+
+  // Queued for the background request logger when it is enabled
+  void saveRequestResult(
+      const std::string& token,
+      const std::string& longUrlFind,
+      const int request_timeout_second,
+      const int request_attempt,
+      const int request_code,
+      const std::string& error) const;
+
+  std::optional<LinkTarget> findCachedLink(const std::string& token, const int64_t id) const;
+  std::optional<LinkTarget> findLink(const std::string& token, const int64_t id) const;
+
+  // Stores the url under the token unless it is already stored, the
+  // result always carries the token the url is reachable by
+  StoredLink shortenUrl(const std::string& token, const std::string& longUrl,
+                        const LinkOptions& options = {}) const;
+
   userver::clients::http::Client& http_client_;
 
   DBHelper m_dbHelper;
   DBCleaner m_dbCleaner;
+  RetryPolicy m_upstreamRetry;
+  IDGenerator m_idGenerator;
+  TokenGenerator m_tokenGenerator;
+  std::unique_ptr<LinkCache<LinkTarget>> m_linkCache;
+  std::unique_ptr<LinkCache<std::string>> m_urlCache;
+  std::unique_ptr<ResponseCache> m_responseCache;
+  // Concurrent GETs of one token share the database lookup, of one long url the upstream fetch
+  std::unique_ptr<SingleFlight<std::optional<LongUrlInfo>>> m_lookupFlight;
+  std::unique_ptr<SingleFlight<RetryPolicy::Result>> m_upstreamFlight;
+  const LinkStoreCache* m_linkStoreCache;
+  std::unique_ptr<TokenFilter> m_tokenFilter;
+  std::unique_ptr<RequestLogger> m_requestLogger;
+  std::unique_ptr<LinkAccessRecorder> m_accessRecorder;
+  std::size_t m_batchMaxSize;
+  ResponseMode m_responseMode;
+  std::optional<ProxyStreamSettings> m_proxyStream;
 };
 
 
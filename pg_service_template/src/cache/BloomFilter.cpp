@@ -0,0 +1,78 @@
+#include "BloomFilter.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "../exceptions/InternalException.hpp"
+
+namespace {
+
+constexpr std::size_t WORD_BITS = 64;
+
+}  // namespace
+
+std::uint64_t BloomFilter::mix(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+BloomFilter::BloomFilter(std::size_t expectedItems, double falsePositiveRate)
+{
+    if (expectedItems == 0 || falsePositiveRate <= 0.0 || falsePositiveRate >= 1.0)
+    {
+        throw InternalLogicException("Bloom filter needs positive expected items and a false positive rate in (0, 1)");
+    }
+
+    const double ln2 = std::log(2.0);
+    const double bits = -static_cast<double>(expectedItems) * std::log(falsePositiveRate) / (ln2 * ln2);
+    const std::size_t words = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(bits / WORD_BITS)));
+
+    m_bitsCount = words * WORD_BITS;
+    m_hashesCount = std::max<std::size_t>(1, static_cast<std::size_t>(
+        std::lround(static_cast<double>(m_bitsCount) / expectedItems * ln2)));
+    m_words = std::make_unique<std::atomic<std::uint64_t>[]>(words);
+}
+
+void BloomFilter::add(std::uint64_t hash)
+{
+    // Double hashing: the k probes are h1 + i * h2
+    const std::uint64_t h2 = mix(hash) | 1;
+    std::uint64_t probe = hash;
+    for (std::size_t i = 0; i < m_hashesCount; ++i, probe += h2)
+    {
+        const auto bit = probe % m_bitsCount;
+        m_words[bit / WORD_BITS].fetch_or(std::uint64_t{1} << (bit % WORD_BITS), std::memory_order_relaxed);
+    }
+    m_itemsCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BloomFilter::mayContain(std::uint64_t hash) const
+{
+    const std::uint64_t h2 = mix(hash) | 1;
+    std::uint64_t probe = hash;
+    for (std::size_t i = 0; i < m_hashesCount; ++i, probe += h2)
+    {
+        const auto bit = probe % m_bitsCount;
+        if ((m_words[bit / WORD_BITS].load(std::memory_order_relaxed) & (std::uint64_t{1} << (bit % WORD_BITS))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+double BloomFilter::estimatedFalsePositiveRate() const
+{
+    std::size_t setBits = 0;
+    for (std::size_t i = 0; i < m_bitsCount / WORD_BITS; ++i)
+    {
+        setBits += std::popcount(m_words[i].load(std::memory_order_relaxed));
+    }
+    return std::pow(static_cast<double>(setBits) / m_bitsCount, static_cast<double>(m_hashesCount));
+}
@@ -0,0 +1,42 @@
+#ifndef __BLOOM_FILTER_HPP__
+#define __BLOOM_FILTER_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Fixed-size Bloom filter over 64-bit key hashes. Keys can be added
+ * concurrently with lookups, there is no removal: deleted keys are shed by
+ * building a new filter.
+ */
+class BloomFilter
+{
+public:
+    BloomFilter(std::size_t expectedItems, double falsePositiveRate);
+
+    /// splitmix64 finalizer, spreads integer keys such as sequential ids
+    static std::uint64_t mix(std::uint64_t x);
+
+    void add(std::uint64_t hash);
+    bool mayContain(std::uint64_t hash) const;
+
+    std::size_t bitsCount() const { return m_bitsCount; }
+    std::size_t hashesCount() const { return m_hashesCount; }
+    std::size_t itemsCount() const { return m_itemsCount.load(std::memory_order_relaxed); }
+
+    /// False positive rate expected from the current share of set bits
+    double estimatedFalsePositiveRate() const;
+
+private:
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    std::size_t m_bitsCount;
+    std::size_t m_hashesCount;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_words;
+    std::atomic<std::size_t> m_itemsCount{0};
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "LinkCache.hpp"
+
+#include <functional>
+#include <mutex>
+
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/InternalException.hpp"
+
+template <typename Value>
+LinkCache<Value>::LinkCache(const Settings& settings, const std::string& statisticsName,
+                            userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings)
+{
+    if (m_settings.shardsCount == 0 || m_settings.capacity < m_settings.shardsCount)
+    {
+        throw InternalLogicException("Link cache capacity must be at least one entry per shard");
+    }
+
+    const auto shardCapacity = m_settings.capacity / m_settings.shardsCount;
+    m_shards.reserve(m_settings.shardsCount);
+    for (std::size_t i = 0; i < m_settings.shardsCount; ++i)
+    {
+        m_shards.push_back(std::make_unique<Shard>(shardCapacity));
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        statisticsName, [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+}
+
+template <typename Value>
+LinkCache<Value>::~LinkCache()
+{
+    m_statisticsEntry.Unregister();
+}
+
+template <typename Value>
+std::optional<Value> LinkCache<Value>::get(const std::string& key)
+{
+    auto& shard = shardOf(key);
+    const auto now = Clock::now();
+    {
+        const std::lock_guard lock(shard.mutex);
+        const auto* entry = shard.entries.Get(key);
+        if (entry != nullptr)
+        {
+            if (entry->deadline > now)
+            {
+                m_hits.fetch_add(1, std::memory_order_relaxed);
+                return entry->value;
+            }
+            shard.entries.Erase(key);
+            m_expired.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+template <typename Value>
+void LinkCache<Value>::put(const std::string& key, const Value& value,
+                           std::optional<std::chrono::seconds> timeToLive)
+{
+    std::chrono::milliseconds ttl = m_settings.maxTimeToLive;
+    if (timeToLive.has_value() && timeToLive.value() < ttl)
+    {
+        ttl = timeToLive.value();
+    }
+    if (ttl <= std::chrono::milliseconds::zero())
+    {
+        return;
+    }
+
+    auto& shard = shardOf(key);
+    Entry entry{value, Clock::now() + ttl};
+
+    const std::lock_guard lock(shard.mutex);
+    const bool full = shard.entries.GetSize() >= shard.capacity;
+    if (shard.entries.Put(key, std::move(entry)) && full)
+    {
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename Value>
+void LinkCache<Value>::erase(const std::string& key)
+{
+    auto& shard = shardOf(key);
+    const std::lock_guard lock(shard.mutex);
+    shard.entries.Erase(key);
+    m_invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename Value>
+typename LinkCache<Value>::Shard& LinkCache<Value>::shardOf(const std::string& key)
+{
+    // Remix the hash, the shard maps hash the same key with std::hash again
+    const auto hash = std::hash<std::string>{}(key) * 0x9E3779B97F4A7C15ull;
+    return *m_shards[(hash >> 32) % m_shards.size()];
+}
+
+template <typename Value>
+void LinkCache<Value>::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    std::uint64_t size = 0;
+    for (const auto& shard : m_shards)
+    {
+        const std::lock_guard lock(shard->mutex);
+        size += shard->entries.GetSize();
+    }
+
+    writer["size"] = size;
+    writer["capacity"] = static_cast<std::uint64_t>(m_settings.capacity);
+    writer["hits"] = userver::utils::statistics::Rate{m_hits.load()};
+    writer["misses"] = userver::utils::statistics::Rate{m_misses.load()};
+    writer["expired"] = userver::utils::statistics::Rate{m_expired.load()};
+    writer["evictions"] = userver::utils::statistics::Rate{m_evictions.load()};
+    writer["invalidations"] = userver::utils::statistics::Rate{m_invalidations.load()};
+}
+
+template class LinkCache<std::string>;
+template class LinkCache<LinkTarget>;
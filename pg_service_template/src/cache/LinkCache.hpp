@@ -0,0 +1,95 @@
+#ifndef __LINK_CACHE_HPP__
+#define __LINK_CACHE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <userver/cache/lru_map.hpp>
+#include <userver/engine/mutex.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+#include "../db/DBHelper.hpp"
+
+/**
+ * In-process cache in front of the linkstore table, used for token -> link
+ * target lookups of redirects and long url digest -> token lookups of PUT.
+ * Instantiated for std::string and LinkTarget values only.
+ * Keys are spread over independently locked LRU shards, so concurrent
+ * requests for different links rarely contend. Every entry carries its own
+ * deadline: a cached link never outlives its expiry in the database.
+ */
+struct LinkCacheSettings
+{
+    std::size_t capacity = 100000;
+    std::size_t shardsCount = 16;
+    std::chrono::milliseconds maxTimeToLive{60000};
+};
+
+template <typename Value>
+class LinkCache
+{
+public:
+    using Settings = LinkCacheSettings;
+
+    LinkCache(const Settings& settings, const std::string& statisticsName,
+              userver::utils::statistics::Storage& statisticsStorage);
+    ~LinkCache();
+
+    std::optional<Value> get(const std::string& key);
+
+    /**
+     * Caches a value for at most timeToLive, further bounded by the
+     * max-ttl of the cache. std::nullopt means the link never expires.
+     */
+    void put(const std::string& key, const Value& value,
+             std::optional<std::chrono::seconds> timeToLive);
+
+    void erase(const std::string& key);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        Value value;
+        Clock::time_point deadline;
+    };
+
+    struct Shard
+    {
+        explicit Shard(std::size_t capacity) : capacity(capacity), entries(capacity) {}
+
+        const std::size_t capacity;
+        userver::engine::Mutex mutex;
+        userver::cache::LruMap<std::string, Entry> entries;
+    };
+
+    LinkCache(const LinkCache&) = delete;
+    LinkCache& operator=(const LinkCache&) = delete;
+
+    Shard& shardOf(const std::string& key);
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    std::atomic<std::uint64_t> m_hits{0};
+    std::atomic<std::uint64_t> m_misses{0};
+    std::atomic<std::uint64_t> m_expired{0};
+    std::atomic<std::uint64_t> m_evictions{0};
+    std::atomic<std::uint64_t> m_invalidations{0};
+
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+extern template class LinkCache<std::string>;
+extern template class LinkCache<LinkTarget>;
+
+#endif
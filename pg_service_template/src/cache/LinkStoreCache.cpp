@@ -0,0 +1,247 @@
+#include "LinkStoreCache.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <userver/components/statistics_storage.hpp>
+#include <userver/logging/log.hpp>
+#include <userver/storages/postgres/component.hpp>
+#include <userver/utils/statistics/rate.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
+
+#include "../exceptions/InternalException.hpp"
+
+namespace {
+
+// Approximate heap size of an unordered_map node holding the entry
+template <typename Key>
+std::size_t entrySize(const Key& key, const LinkStoreEntry& entry)
+{
+    std::size_t size = sizeof(std::pair<const Key, LinkStoreEntry>) + 2 * sizeof(void*)
+        + entry.target.longUrl.capacity();
+    if constexpr (std::is_same_v<Key, std::string>)
+    {
+        size += key.capacity();
+    }
+    return size;
+}
+
+template <typename Key>
+void applyLink(std::unordered_map<Key, LinkStoreEntry>& links, std::size_t& memoryBytes,
+               const Key& key, const LinkStoreRow& row, std::chrono::steady_clock::time_point now)
+{
+    LinkStoreEntry entry{LinkTarget{row.link, std::nullopt}, std::nullopt};
+    if (row.responseMode.has_value())
+    {
+        entry.target.responseMode = static_cast<ResponseMode>(row.responseMode.value());
+    }
+    if (row.secondsLeft.has_value())
+    {
+        entry.expiresAt = now + std::chrono::seconds{row.secondsLeft.value()};
+    }
+
+    memoryBytes += entrySize(key, entry);
+    const auto [it, inserted] = links.try_emplace(key, entry);
+    if (!inserted)
+    {
+        memoryBytes -= entrySize(it->first, it->second);
+        it->second = std::move(entry);
+    }
+}
+
+template <typename Key>
+std::optional<LinkTarget> findLive(const std::unordered_map<Key, LinkStoreEntry>& links, const Key& key)
+{
+    const auto it = links.find(key);
+    if (it == links.end())
+    {
+        return std::nullopt;
+    }
+    // Expired links stay until the tombstone of the cleaner arrives
+    const auto& expiresAt = it->second.expiresAt;
+    if (expiresAt.has_value() && expiresAt.value() <= std::chrono::steady_clock::now())
+    {
+        return std::nullopt;
+    }
+    return it->second.target;
+}
+
+template <typename Key>
+bool applyTombstone(std::unordered_map<Key, LinkStoreEntry>& links, std::size_t& memoryBytes,
+                    const Key& key)
+{
+    const auto it = links.find(key);
+    if (it == links.end())
+    {
+        return false;
+    }
+    memoryBytes -= entrySize(it->first, it->second);
+    links.erase(it);
+    return true;
+}
+
+LinkStoreKey makeLinkStoreKey(const userver::yaml_config::YamlConfig& config)
+{
+    const auto key = config["linkstore-key"].As<std::string>("token");
+    if (key == "token")
+    {
+        return LinkStoreKey::token;
+    }
+    if (key == "id")
+    {
+        return LinkStoreKey::id;
+    }
+    throw InternalLogicException("linkstore-key must be either 'token' or 'id'");
+}
+
+}  // namespace
+
+LinkStoreCache::LinkStoreCache(const userver::components::ComponentConfig& config,
+                               const userver::components::ComponentContext& context)
+    : CachingComponentBase(config, context),
+      m_dbHelper(
+          context
+              .FindComponent<userver::components::Postgres>("postgres-db-1")
+              .GetCluster(),
+          makeLinkStoreKey(config))
+{
+    m_statisticsEntry =
+        context.FindComponent<userver::components::StatisticsStorage>().GetStorage().RegisterWriter(
+            "linkstore-cache", [this](userver::utils::statistics::Writer& writer) {
+                writeStatistics(writer);
+            });
+
+    StartPeriodicUpdates();
+}
+
+LinkStoreCache::~LinkStoreCache()
+{
+    StopPeriodicUpdates();
+    m_statisticsEntry.Unregister();
+}
+
+std::optional<LinkTarget> LinkStoreCache::getLink(const std::string& token, int64_t id) const
+{
+    // Empty until the first successful load
+    const auto data = GetUnsafe();
+    if (!data)
+    {
+        return std::nullopt;
+    }
+
+    return m_dbHelper.keyMode() == LinkStoreKey::id
+        ? findLive(data->byId, id)
+        : findLive(data->byToken, token);
+}
+
+void LinkStoreCache::Update(userver::cache::UpdateType type,
+                            const std::chrono::system_clock::time_point& last_update,
+                            const std::chrono::system_clock::time_point& now,
+                            userver::cache::UpdateStatisticsScope& stats_scope)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const auto previous = GetUnsafe();
+    bool full = type == userver::cache::UpdateType::kFull || !previous;
+
+    std::optional<userver::storages::postgres::TimePointWithoutTz> since;
+    if (!full)
+    {
+        since = userver::storages::postgres::TimePointWithoutTz{last_update - UPDATE_CORRECTION};
+    }
+
+    auto tombstones = full ? std::vector<LinkStoreRow>{} : m_dbHelper.loadTombstones(since.value());
+    // A tombstone without a key stands for a dropped linkstore partition
+    const bool partitionDropped = std::any_of(tombstones.cbegin(), tombstones.cend(),
+        [](const LinkStoreRow& row) { return row.token.empty() && row.id == 0; });
+    if (partitionDropped)
+    {
+        LOG_INFO() << "A linkstore partition was dropped, reloading all links";
+        full = true;
+        since.reset();
+        tombstones.clear();
+    }
+
+    const auto links = m_dbHelper.loadLinks(since);
+    stats_scope.IncreaseDocumentsReadCount(links.size() + tombstones.size());
+
+    if (!full && links.empty() && tombstones.empty())
+    {
+        m_lastUpdateTime = now.time_since_epoch().count();
+        stats_scope.FinishNoChanges();
+        return;
+    }
+
+    auto data = full ? std::make_unique<LinkStoreData>() : std::make_unique<LinkStoreData>(*previous);
+    const bool byId = m_dbHelper.keyMode() == LinkStoreKey::id;
+    const auto loaded = std::chrono::steady_clock::now();
+    for (const auto& row : links)
+    {
+        if (byId)
+        {
+            applyLink(data->byId, data->memoryBytes, row.id, row, loaded);
+        }
+        else
+        {
+            applyLink(data->byToken, data->memoryBytes, row.token, row, loaded);
+        }
+    }
+
+    std::uint64_t applied = 0;
+    for (const auto& row : tombstones)
+    {
+        applied += byId
+          ? applyTombstone(data->byId, data->memoryBytes, row.id)
+          : applyTombstone(data->byToken, data->memoryBytes, row.token);
+    }
+    m_tombstonesApplied.fetch_add(applied, std::memory_order_relaxed);
+
+    const auto size = byId ? data->byId.size() : data->byToken.size();
+    Set(std::move(data));
+    stats_scope.Finish(size);
+
+    m_lastUpdateTime = now.time_since_epoch().count();
+    if (full)
+    {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started);
+        m_lastFullLoadMs = elapsed.count();
+        LOG_INFO() << "Loaded " << size << " links in " << elapsed.count() << " ms";
+    }
+}
+
+void LinkStoreCache::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    const auto data = GetUnsafe();
+    if (data)
+    {
+        writer["rows"] = static_cast<std::uint64_t>(
+            m_dbHelper.keyMode() == LinkStoreKey::id ? data->byId.size() : data->byToken.size());
+        writer["memory-bytes"] = static_cast<std::uint64_t>(data->memoryBytes);
+    }
+    writer["last-full-load-ms"] = m_lastFullLoadMs.load();
+
+    const std::chrono::system_clock::time_point lastUpdate{
+        std::chrono::system_clock::duration{m_lastUpdateTime.load()}};
+    writer["update-lag-ms"] = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now() - lastUpdate).count());
+    writer["tombstones-applied"] = userver::utils::statistics::Rate{m_tombstonesApplied.load()};
+}
+
+userver::yaml_config::Schema LinkStoreCache::GetStaticConfigSchema()
+{
+    return userver::yaml_config::MergeSchemas<CachingComponentBase<LinkStoreData>>(R"(
+type: object
+description: full in-memory copy of the linkstore table
+additionalProperties: false
+properties:
+    linkstore-key:
+        type: string
+        description: primary key of the linkstore table, must match the one of the url shortener handler
+        enum:
+          - token
+          - id
+)");
+}
@@ -0,0 +1,85 @@
+#ifndef __LINK_STORE_CACHE_HPP__
+#define __LINK_STORE_CACHE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <userver/cache/caching_component_base.hpp>
+#include <userver/components/component_context.hpp>
+#include <userver/utils/statistics/entry.hpp>
+#include <userver/utils/statistics/writer.hpp>
+#include <userver/yaml_config/schema.hpp>
+
+#include "../db/DBHelper.hpp"
+
+/**
+ * A cached link, served until its expiry as seen when it was loaded. Expiry
+ * extended by sliding afterwards is found in the database.
+ */
+struct LinkStoreEntry
+{
+    LinkTarget target;
+    std::optional<std::chrono::steady_clock::time_point> expiresAt;
+};
+
+/**
+ * Snapshot of the whole linkstore table. Only the map of the configured
+ * LinkStoreKey mode is filled.
+ */
+struct LinkStoreData
+{
+    std::unordered_map<std::string, LinkStoreEntry> byToken;
+    std::unordered_map<int64_t, LinkStoreEntry> byId;
+    std::size_t memoryBytes = 0;
+};
+
+/**
+ * Keeps the entire linkstore table in memory. The first update loads every
+ * row, later incremental updates read links created since the previous
+ * update and drop the ones recorded in linkstore_tombstone by deletes and
+ * by the expired data cleaner. Periodic full updates rebuild the snapshot
+ * from scratch, so they must run more often than tombstones are kept.
+ */
+class LinkStoreCache final : public userver::components::CachingComponentBase<LinkStoreData>
+{
+public:
+    static constexpr std::string_view kName = "linkstore-cache";
+
+    LinkStoreCache(const userver::components::ComponentConfig& config,
+                   const userver::components::ComponentContext& context);
+    ~LinkStoreCache() override;
+
+    static userver::yaml_config::Schema GetStaticConfigSchema();
+
+    LinkStoreKey keyMode() const { return m_dbHelper.keyMode(); }
+
+    std::optional<LinkTarget> getLink(const std::string& token, int64_t id) const;
+
+private:
+    // Rows of transactions that were still running during the previous
+    // update carry an earlier create_time, so every update overlaps a bit
+    static constexpr std::chrono::seconds UPDATE_CORRECTION{5};
+
+    void Update(userver::cache::UpdateType type,
+                const std::chrono::system_clock::time_point& last_update,
+                const std::chrono::system_clock::time_point& now,
+                userver::cache::UpdateStatisticsScope& stats_scope) override;
+
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    DBHelper m_dbHelper;
+
+    std::atomic<std::uint64_t> m_lastFullLoadMs{0};
+    std::atomic<std::int64_t> m_lastUpdateTime{0};
+    std::atomic<std::uint64_t> m_tombstonesApplied{0};
+
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
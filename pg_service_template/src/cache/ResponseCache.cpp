@@ -0,0 +1,509 @@
+#include "ResponseCache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <functional>
+#include <mutex>
+#include <set>
+
+#include <userver/utils/datetime.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/InternalException.hpp"
+
+namespace {
+
+using HeaderMap = ResponseCache::HeaderMap;
+
+// Headers describing the body, sent again with every cached answer
+const std::set<std::string> kStoredHeaders{
+    "cache-control", "content-disposition", "content-encoding", "content-language",
+    "content-type", "etag", "expires", "last-modified", "vary"};
+
+std::string lower(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return value;
+}
+
+std::string trim(const std::string& value)
+{
+    const auto begin = value.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+    {
+        return {};
+    }
+    return value.substr(begin, value.find_last_not_of(" \t") - begin + 1);
+}
+
+std::vector<std::string> splitList(const std::string& value)
+{
+    std::vector<std::string> items;
+    std::size_t begin = 0;
+    while (begin <= value.size())
+    {
+        const auto end = std::min(value.find(',', begin), value.size());
+        auto item = trim(value.substr(begin, end - begin));
+        if (!item.empty())
+        {
+            items.push_back(std::move(item));
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+std::string headerOf(const HeaderMap& headers, const std::string& name)
+{
+    const auto it = headers.find(name);
+    return it == headers.end() ? std::string{} : it->second;
+}
+
+std::optional<int64_t> parseSeconds(const std::string& value)
+{
+    int64_t seconds = 0;
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+    if (error != std::errc{} || end != value.data() + value.size() || seconds < 0)
+    {
+        return std::nullopt;
+    }
+    return seconds;
+}
+
+std::optional<std::chrono::system_clock::time_point> parseHttpDate(const std::string& value)
+{
+    try
+    {
+        return userver::utils::datetime::Stringtime(value, "UTC", "%a, %d %b %Y %H:%M:%S GMT");
+    }
+    catch (const std::exception&)
+    {
+        return std::nullopt;
+    }
+}
+
+struct CacheControl
+{
+    bool noStore = false;
+    bool noCache = false;
+    bool isPrivate = false;
+    bool isPublic = false;
+    bool mustRevalidate = false;
+    std::optional<int64_t> maxAge;
+    std::optional<int64_t> sharedMaxAge;
+};
+
+CacheControl parseCacheControl(const std::string& value)
+{
+    CacheControl control;
+    for (const auto& directive : splitList(value))
+    {
+        const auto separator = directive.find('=');
+        const auto name = lower(trim(directive.substr(0, separator)));
+        auto argument = separator == std::string::npos ? std::string{} : trim(directive.substr(separator + 1));
+        if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"')
+        {
+            argument = argument.substr(1, argument.size() - 2);
+        }
+
+        if (name == "no-store")
+        {
+            control.noStore = true;
+        }
+        else if (name == "no-cache")
+        {
+            control.noCache = true;
+        }
+        else if (name == "private")
+        {
+            control.isPrivate = true;
+        }
+        else if (name == "public")
+        {
+            control.isPublic = true;
+        }
+        else if (name == "must-revalidate")
+        {
+            control.mustRevalidate = true;
+        }
+        else if (name == "max-age")
+        {
+            control.maxAge = parseSeconds(argument);
+        }
+        else if (name == "s-maxage")
+        {
+            control.sharedMaxAge = parseSeconds(argument);
+        }
+    }
+    return control;
+}
+
+/**
+ * How long an answer may be served without revalidation, std::nullopt when
+ * a shared cache must not store it. Without explicit freshness the answer
+ * is stale at once and is only kept when it can be revalidated.
+ */
+std::optional<std::chrono::seconds> freshnessLifetime(const HeaderMap& headers)
+{
+    const auto control = parseCacheControl(headerOf(headers, "Cache-Control"));
+    if (control.noStore || control.isPrivate)
+    {
+        return std::nullopt;
+    }
+
+    std::chrono::seconds lifetime{0};
+    if (control.noCache)
+    {
+        return lifetime;
+    }
+    if (control.sharedMaxAge.has_value())
+    {
+        lifetime = std::chrono::seconds{control.sharedMaxAge.value()};
+    }
+    else if (control.maxAge.has_value())
+    {
+        lifetime = std::chrono::seconds{control.maxAge.value()};
+    }
+    else if (headers.find("Expires") != headers.end())
+    {
+        // An invalid Expires means already expired
+        const auto expires = parseHttpDate(headerOf(headers, "Expires"));
+        const auto date = parseHttpDate(headerOf(headers, "Date"));
+        if (expires.has_value())
+        {
+            const auto base = date.value_or(std::chrono::system_clock::now());
+            lifetime = std::max(std::chrono::seconds{0},
+                                std::chrono::duration_cast<std::chrono::seconds>(expires.value() - base));
+        }
+    }
+
+    const auto age = parseSeconds(headerOf(headers, "Age"));
+    if (age.has_value())
+    {
+        lifetime = std::max(std::chrono::seconds{0}, lifetime - std::chrono::seconds{age.value()});
+    }
+    return lifetime;
+}
+
+std::vector<std::string> varyNamesOf(const HeaderMap& responseHeaders)
+{
+    auto names = splitList(headerOf(responseHeaders, "Vary"));
+    for (auto& name : names)
+    {
+        name = lower(std::move(name));
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+std::vector<std::string> varyValuesOf(const std::vector<std::string>& names, const HeaderMap& requestHeaders)
+{
+    std::vector<std::string> values;
+    values.reserve(names.size());
+    for (const auto& name : names)
+    {
+        values.push_back(headerOf(requestHeaders, name));
+    }
+    return values;
+}
+
+}  // namespace
+
+ResponseCache::ResponseCache(const Settings& settings, userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings),
+      m_shardBytes(settings.shardsCount == 0 ? 0 : settings.maxBytes / settings.shardsCount)
+{
+    if (m_settings.shardsCount == 0 || m_shardBytes == 0 || m_settings.maxVariants == 0)
+    {
+        throw InternalLogicException("Response cache needs shards, variants and at least one byte per shard");
+    }
+
+    m_shards.reserve(m_settings.shardsCount);
+    for (std::size_t i = 0; i < m_settings.shardsCount; ++i)
+    {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        "response-cache", [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+}
+
+ResponseCache::~ResponseCache()
+{
+    m_statisticsEntry.Unregister();
+}
+
+bool ResponseCache::isStorable(const HeaderMap& requestHeaders, const HeaderMap& responseHeaders)
+{
+    // RFC 9111 3.5: an answer to an authorized request is only shared when
+    // the upstream explicitly allows it
+    if (requestHeaders.find("Authorization") != requestHeaders.end())
+    {
+        const auto control = parseCacheControl(headerOf(responseHeaders, "Cache-Control"));
+        if (!control.isPublic && !control.mustRevalidate && !control.sharedMaxAge.has_value())
+        {
+            return false;
+        }
+    }
+
+    const auto varyNames = varyNamesOf(responseHeaders);
+    if (std::find(varyNames.begin(), varyNames.end(), "*") != varyNames.end())
+    {
+        return false;
+    }
+
+    const auto lifetime = freshnessLifetime(responseHeaders);
+    if (!lifetime.has_value())
+    {
+        return false;
+    }
+    // A response stale at once is only worth keeping for revalidation
+    return lifetime.value() > std::chrono::seconds::zero()
+        || responseHeaders.find("ETag") != responseHeaders.end()
+        || responseHeaders.find("Last-Modified") != responseHeaders.end();
+}
+
+std::vector<std::pair<std::string, std::string>> ResponseCache::endToEndHeaders(const HeaderMap& responseHeaders)
+{
+    std::vector<std::pair<std::string, std::string>> headers;
+    for (const auto& [name, value] : responseHeaders)
+    {
+        if (kStoredHeaders.count(lower(name)) != 0)
+        {
+            headers.emplace_back(name, value);
+        }
+    }
+    return headers;
+}
+
+void ResponseCache::addValidators(const Response& response, HeaderMap& requestHeaders)
+{
+    if (!response.etag.empty())
+    {
+        requestHeaders.InsertOrAssign(std::string{"If-None-Match"}, response.etag);
+    }
+    if (!response.lastModified.empty())
+    {
+        requestHeaders.InsertOrAssign(std::string{"If-Modified-Since"}, response.lastModified);
+    }
+}
+
+ResponseCache::Lookup ResponseCache::get(const std::string& url, const HeaderMap& requestHeaders)
+{
+    auto& shard = shardOf(url);
+    const auto now = Clock::now();
+
+    const std::lock_guard lock(shard.mutex);
+    const auto entry = shard.entries.find(url);
+    if (entry == shard.entries.end())
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry->second.lruPosition);
+
+    auto& variants = entry->second.variants;
+    const auto values = varyValuesOf(entry->second.varyNames, requestHeaders);
+    const auto variant = std::find_if(variants.begin(), variants.end(),
+                                      [&values](const Variant& v) { return v.varyValues == values; });
+    if (variant == variants.end())
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    if (variant->freshUntil > now)
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        m_bytesSaved.fetch_add(variant->response->body.size(), std::memory_order_relaxed);
+        return {variant->response, true};
+    }
+    m_stale.fetch_add(1, std::memory_order_relaxed);
+    return {variant->response, false};
+}
+
+void ResponseCache::put(const std::string& url, const HeaderMap& requestHeaders,
+                        const HeaderMap& responseHeaders, std::string body)
+{
+    if (!isStorable(requestHeaders, responseHeaders))
+    {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto response = std::make_shared<Response>();
+    response->headers = endToEndHeaders(responseHeaders);
+    std::size_t bytes = url.size() + body.size();
+    for (const auto& [name, value] : response->headers)
+    {
+        bytes += name.size() + value.size();
+    }
+    if (bytes > m_settings.maxEntryBytes || bytes > m_shardBytes)
+    {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    response->body = std::move(body);
+    response->etag = headerOf(responseHeaders, "ETag");
+    response->lastModified = headerOf(responseHeaders, "Last-Modified");
+
+    auto varyNames = varyNamesOf(responseHeaders);
+    Variant variant{varyValuesOf(varyNames, requestHeaders), std::move(response),
+                    Clock::now() + freshnessLifetime(responseHeaders).value(), bytes};
+
+    auto& shard = shardOf(url);
+    const std::lock_guard lock(shard.mutex);
+    auto [it, inserted] = shard.entries.try_emplace(url);
+    auto& entry = it->second;
+    if (inserted)
+    {
+        shard.lru.push_front(url);
+        entry.lruPosition = shard.lru.begin();
+    }
+    else
+    {
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruPosition);
+    }
+
+    // Variants told apart by other headers can not be matched any more
+    if (entry.varyNames != varyNames)
+    {
+        shard.bytes -= entry.bytes;
+        entry.bytes = 0;
+        entry.variants.clear();
+        entry.varyNames = std::move(varyNames);
+    }
+
+    const auto same = std::find_if(entry.variants.begin(), entry.variants.end(),
+                                   [&variant](const Variant& v) { return v.varyValues == variant.varyValues; });
+    if (same != entry.variants.end())
+    {
+        entry.bytes -= same->bytes;
+        shard.bytes -= same->bytes;
+        entry.variants.erase(same);
+    }
+    else if (entry.variants.size() >= m_settings.maxVariants)
+    {
+        entry.bytes -= entry.variants.back().bytes;
+        shard.bytes -= entry.variants.back().bytes;
+        entry.variants.pop_back();
+    }
+
+    entry.bytes += variant.bytes;
+    shard.bytes += variant.bytes;
+    entry.variants.push_front(std::move(variant));
+    m_stored.fetch_add(1, std::memory_order_relaxed);
+
+    evict(shard);
+}
+
+void ResponseCache::revalidated(const std::string& url, const HeaderMap& requestHeaders,
+                                const HeaderMap& notModifiedHeaders)
+{
+    auto& shard = shardOf(url);
+    const std::lock_guard lock(shard.mutex);
+    const auto entry = shard.entries.find(url);
+    if (entry == shard.entries.end())
+    {
+        return;
+    }
+
+    auto& variants = entry->second.variants;
+    const auto values = varyValuesOf(entry->second.varyNames, requestHeaders);
+    const auto variant = std::find_if(variants.begin(), variants.end(),
+                                      [&values](const Variant& v) { return v.varyValues == values; });
+    if (variant == variants.end())
+    {
+        return;
+    }
+    m_revalidated.fetch_add(1, std::memory_order_relaxed);
+    m_bytesSaved.fetch_add(variant->response->body.size(), std::memory_order_relaxed);
+
+    HeaderMap merged;
+    for (const auto& [name, value] : variant->response->headers)
+    {
+        merged.InsertOrAssign(name, value);
+    }
+    for (const auto& [name, value] : notModifiedHeaders)
+    {
+        merged.InsertOrAssign(name, value);
+    }
+
+    const auto lifetime = freshnessLifetime(merged);
+    if (lifetime.has_value())
+    {
+        variant->freshUntil = Clock::now() + lifetime.value();
+        return;
+    }
+
+    // The upstream forbids storing it from now on
+    entry->second.bytes -= variant->bytes;
+    shard.bytes -= variant->bytes;
+    variants.erase(variant);
+    if (variants.empty())
+    {
+        erase(shard, url);
+    }
+}
+
+ResponseCache::Shard& ResponseCache::shardOf(const std::string& url)
+{
+    const auto hash = std::hash<std::string>{}(url) * 0x9E3779B97F4A7C15ull;
+    return *m_shards[(hash >> 32) % m_shards.size()];
+}
+
+void ResponseCache::evict(Shard& shard)
+{
+    while (shard.bytes > m_shardBytes && !shard.lru.empty())
+    {
+        erase(shard, shard.lru.back());
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ResponseCache::erase(Shard& shard, const std::string& url)
+{
+    const auto entry = shard.entries.find(url);
+    if (entry == shard.entries.end())
+    {
+        return;
+    }
+    shard.bytes -= entry->second.bytes;
+    shard.lru.erase(entry->second.lruPosition);
+    shard.entries.erase(entry);
+}
+
+void ResponseCache::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    std::uint64_t bytes = 0;
+    std::uint64_t urls = 0;
+    for (const auto& shard : m_shards)
+    {
+        const std::lock_guard lock(shard->mutex);
+        bytes += shard->bytes;
+        urls += shard->entries.size();
+    }
+
+    const auto hits = m_hits.load();
+    const auto revalidated = m_revalidated.load();
+    const auto lookups = hits + m_stale.load() + m_misses.load();
+
+    writer["size-bytes"] = bytes;
+    writer["max-bytes"] = static_cast<std::uint64_t>(m_settings.maxBytes);
+    writer["urls"] = urls;
+    // Share of lookups answered without downloading the body again
+    writer["hit-ratio"] = lookups == 0 ? 0.0 : static_cast<double>(hits + revalidated) / lookups;
+    writer["hits"] = userver::utils::statistics::Rate{hits};
+    writer["misses"] = userver::utils::statistics::Rate{m_misses.load()};
+    writer["stale"] = userver::utils::statistics::Rate{m_stale.load()};
+    writer["revalidated"] = userver::utils::statistics::Rate{revalidated};
+    writer["stored"] = userver::utils::statistics::Rate{m_stored.load()};
+    writer["rejected"] = userver::utils::statistics::Rate{m_rejected.load()};
+    writer["evictions"] = userver::utils::statistics::Rate{m_evictions.load()};
+    writer["bytes-saved"] = userver::utils::statistics::Rate{m_bytesSaved.load()};
+}
@@ -0,0 +1,146 @@
+#ifndef __RESPONSE_CACHE_HPP__
+#define __RESPONSE_CACHE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <userver/engine/mutex.hpp>
+#include <userver/http/header_map.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+/**
+ * Shared HTTP cache of the upstream answers of proxied links. Entries are
+ * keyed by the long url, every entry keeps a few variants of the answer
+ * told apart by the request headers the upstream names in Vary.
+ * Freshness follows Cache-Control (s-maxage, max-age, no-cache, no-store,
+ * private) and Expires, answers to requests with Authorization are only
+ * stored when marked public, s-maxage or must-revalidate, stale answers carrying an ETag or Last-Modified are
+ * kept for revalidation by a conditional request. The cache is bounded by
+ * the bytes of the stored answers and evicts the least recently used urls,
+ * each shard owns an equal part of the budget.
+ */
+class ResponseCache
+{
+public:
+    using HeaderMap = userver::http::headers::HeaderMap;
+
+    struct Settings
+    {
+        std::size_t maxBytes = 64 << 20;
+        // Larger answers are never stored
+        std::size_t maxEntryBytes = 1 << 20;
+        std::size_t shardsCount = 16;
+        // Variants of one url, the least recently stored one is replaced
+        std::size_t maxVariants = 4;
+        std::chrono::milliseconds revalidateTimeout{1000};
+    };
+
+    struct Response
+    {
+        // End-to-end headers sent along with a cached body
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        std::string etag;
+        std::string lastModified;
+    };
+
+    struct Lookup
+    {
+        // nullptr on a miss
+        std::shared_ptr<const Response> response;
+        // A stale response is answered only after a revalidation
+        bool fresh = false;
+    };
+
+    ResponseCache(const Settings& settings, userver::utils::statistics::Storage& statisticsStorage);
+    ~ResponseCache();
+
+    /// Whether a 200 answer with these headers to such a request may be stored at all
+    static bool isStorable(const HeaderMap& requestHeaders, const HeaderMap& responseHeaders);
+
+    /// Headers of an upstream answer kept along with it and sent to the clients
+    static std::vector<std::pair<std::string, std::string>> endToEndHeaders(const HeaderMap& responseHeaders);
+
+    /// Headers turning a request for the url into a conditional one
+    static void addValidators(const Response& response, HeaderMap& requestHeaders);
+
+    std::size_t maxEntryBytes() const { return m_settings.maxEntryBytes; }
+    std::chrono::milliseconds revalidateTimeout() const { return m_settings.revalidateTimeout; }
+
+    Lookup get(const std::string& url, const HeaderMap& requestHeaders);
+
+    /// Stores a 200 answer unless its headers or its size forbid it
+    void put(const std::string& url, const HeaderMap& requestHeaders,
+             const HeaderMap& responseHeaders, std::string body);
+
+    /**
+     * Renews the freshness of the stored variant after a 304 answer to the
+     * conditional request, the headers of the 304 take precedence over the
+     * stored ones.
+     */
+    void revalidated(const std::string& url, const HeaderMap& requestHeaders,
+                     const HeaderMap& notModifiedHeaders);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Variant
+    {
+        std::vector<std::string> varyValues;
+        std::shared_ptr<const Response> response;
+        Clock::time_point freshUntil;
+        std::size_t bytes = 0;
+    };
+
+    struct Entry
+    {
+        std::vector<std::string> varyNames;
+        std::list<Variant> variants;
+        std::size_t bytes = 0;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    struct Shard
+    {
+        userver::engine::Mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        // Most recently used url first
+        std::list<std::string> lru;
+        std::size_t bytes = 0;
+    };
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    Shard& shardOf(const std::string& url);
+    void evict(Shard& shard);
+    void erase(Shard& shard, const std::string& url);
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    const std::size_t m_shardBytes;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    std::atomic<std::uint64_t> m_hits{0};
+    std::atomic<std::uint64_t> m_misses{0};
+    std::atomic<std::uint64_t> m_stale{0};
+    std::atomic<std::uint64_t> m_revalidated{0};
+    std::atomic<std::uint64_t> m_stored{0};
+    std::atomic<std::uint64_t> m_rejected{0};
+    std::atomic<std::uint64_t> m_evictions{0};
+    std::atomic<std::uint64_t> m_bytesSaved{0};
+
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "SingleFlight.hpp"
+
+#include <mutex>
+
+#include <userver/engine/exception.hpp>
+#include <userver/engine/task/cancel.hpp>
+#include <userver/server/request/task_inherited_data.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/InternalException.hpp"
+
+template <typename Value>
+SingleFlight<Value>::SingleFlight(std::size_t shardsCount, const std::string& statisticsName,
+                                  userver::utils::statistics::Storage& statisticsStorage)
+{
+    if (shardsCount == 0)
+    {
+        throw InternalLogicException("Single flight needs at least one shard");
+    }
+
+    m_shards.reserve(shardsCount);
+    for (std::size_t i = 0; i < shardsCount; ++i)
+    {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        statisticsName, [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+}
+
+template <typename Value>
+SingleFlight<Value>::~SingleFlight()
+{
+    m_statisticsEntry.Unregister();
+}
+
+template <typename Value>
+Value SingleFlight<Value>::run(const std::string& key, const std::function<Value()>& call)
+{
+    auto& shard = shardOf(key);
+    std::unique_lock lock(shard.mutex);
+
+    for (auto inFlight = shard.calls.find(key); inFlight != shard.calls.end(); inFlight = shard.calls.find(key))
+    {
+        const auto running = inFlight->second;
+        if (!running->finished.Wait(lock, [&running] { return running->done; }))
+        {
+            throw userver::engine::WaitInterruptedException(
+                userver::engine::current_task::CancellationReason());
+        }
+        if (!running->abandoned)
+        {
+            m_collapsed.fetch_add(1, std::memory_order_relaxed);
+            if (running->error)
+            {
+                std::rethrow_exception(running->error);
+            }
+            return running->value.value();
+        }
+        // The leader gave up for reasons of its own, the call is run again
+        m_abandoned.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const auto running = std::make_shared<Call>();
+    shard.calls.emplace(key, running);
+    lock.unlock();
+    m_leaders.fetch_add(1, std::memory_order_relaxed);
+
+    std::optional<Value> value;
+    std::exception_ptr error;
+    bool abandoned = false;
+    try
+    {
+        value = call();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+        m_failed.fetch_add(1, std::memory_order_relaxed);
+        // A cancelled leader or one past the deadline of its request says
+        // nothing about the call itself, the waiters still have their time
+        abandoned = userver::engine::current_task::ShouldCancel()
+            || userver::server::request::GetTaskInheritedDeadline().IsReached();
+    }
+
+    lock.lock();
+    running->done = true;
+    running->abandoned = abandoned;
+    running->value = value;
+    running->error = error;
+    shard.calls.erase(key);
+    lock.unlock();
+    running->finished.NotifyAll();
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return std::move(value.value());
+}
+
+template <typename Value>
+typename SingleFlight<Value>::Shard& SingleFlight<Value>::shardOf(const std::string& key)
+{
+    const auto hash = std::hash<std::string>{}(key) * 0x9E3779B97F4A7C15ull;
+    return *m_shards[(hash >> 32) % m_shards.size()];
+}
+
+template <typename Value>
+void SingleFlight<Value>::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    std::uint64_t inFlight = 0;
+    for (const auto& shard : m_shards)
+    {
+        const std::lock_guard lock(shard->mutex);
+        inFlight += shard->calls.size();
+    }
+
+    writer["in-flight"] = inFlight;
+    writer["leaders"] = userver::utils::statistics::Rate{m_leaders.load()};
+    // Calls answered by the result of a call already in flight
+    writer["collapsed"] = userver::utils::statistics::Rate{m_collapsed.load()};
+    writer["failed"] = userver::utils::statistics::Rate{m_failed.load()};
+    // Waiters running the call again after a cancelled or expired leader
+    writer["abandoned"] = userver::utils::statistics::Rate{m_abandoned.load()};
+}
+
+template class SingleFlight<std::optional<LongUrlInfo>>;
+template class SingleFlight<RetryPolicy::Result>;
@@ -0,0 +1,77 @@
+#ifndef __SINGLE_FLIGHT_HPP__
+#define __SINGLE_FLIGHT_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <userver/engine/condition_variable.hpp>
+#include <userver/engine/mutex.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+#include "../db/DBHelper.hpp"
+#include "../retry/RetryPolicy.hpp"
+
+/**
+ * Coalesces concurrent calls for the same key: the first caller runs the
+ * call, the ones arriving while it is in flight wait for its result or its
+ * exception instead of repeating it. When the first caller fails because it
+ * was cancelled or ran out of its deadline, one of the waiters runs the call
+ * again. Nothing is kept once the call is over, the next caller runs it again.
+ * Instantiated for link lookups and upstream responses only.
+ */
+template <typename Value>
+class SingleFlight
+{
+public:
+    SingleFlight(std::size_t shardsCount, const std::string& statisticsName,
+                 userver::utils::statistics::Storage& statisticsStorage);
+    ~SingleFlight();
+
+    Value run(const std::string& key, const std::function<Value()>& call);
+
+private:
+    struct Call
+    {
+        userver::engine::ConditionVariable finished;
+        bool done = false;
+        // The leader failed for reasons of its own, the result is not shared
+        bool abandoned = false;
+        std::optional<Value> value;
+        std::exception_ptr error;
+    };
+
+    struct Shard
+    {
+        userver::engine::Mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Call>> calls;
+    };
+
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    Shard& shardOf(const std::string& key);
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    std::atomic<std::uint64_t> m_leaders{0};
+    std::atomic<std::uint64_t> m_collapsed{0};
+    std::atomic<std::uint64_t> m_failed{0};
+    std::atomic<std::uint64_t> m_abandoned{0};
+
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+extern template class SingleFlight<std::optional<LongUrlInfo>>;
+extern template class SingleFlight<RetryPolicy::Result>;
+
+#endif
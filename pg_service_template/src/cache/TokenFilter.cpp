@@ -0,0 +1,165 @@
+#include "TokenFilter.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include <userver/logging/log.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+TokenFilter::TokenFilter(const Settings& settings, const DBHelper& dbHelper, IdDecoder idDecoder,
+                         userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings),
+      m_dbHelper(dbHelper),
+      m_idDecoder(std::move(idDecoder)),
+      m_filter(std::make_unique<BloomFilter>(settings.expectedItems, settings.falsePositiveRate))
+{
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        "token-filter", [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+}
+
+TokenFilter::~TokenFilter()
+{
+    m_syncTask.Stop();
+    m_statisticsEntry.Unregister();
+}
+
+void TokenFilter::start()
+{
+    rebuild();
+    m_syncTask.Start("token_filter_sync",
+                     userver::utils::PeriodicTask::Settings{m_settings.syncPeriod},
+                     [this] { sync(); });
+}
+
+void TokenFilter::add(std::string_view token, int64_t id)
+{
+    m_filter.Read()->get()->add(hashOf(token, id));
+}
+
+bool TokenFilter::mayContain(std::string_view token, int64_t id)
+{
+    if (m_filter.Read()->get()->mayContain(hashOf(token, id)))
+    {
+        m_positives.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Links of other instances created since the last sync, or any link
+    // while the filter lags behind the table
+    const auto syncedAt = std::chrono::steady_clock::time_point{
+        std::chrono::steady_clock::duration{m_syncedAt.load(std::memory_order_acquire)}};
+    if (id > m_syncedMaxId.load(std::memory_order_acquire)
+        || std::chrono::steady_clock::now() - syncedAt > 2 * m_settings.syncPeriod + SYNC_CORRECTION)
+    {
+        m_unsynced.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    m_negatives.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void TokenFilter::reportFalsePositive()
+{
+    m_falsePositives.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint64_t TokenFilter::hashOf(std::string_view token, int64_t id) const
+{
+    if (m_dbHelper.keyMode() == LinkStoreKey::id)
+    {
+        return BloomFilter::mix(static_cast<std::uint64_t>(id));
+    }
+    return std::hash<std::string_view>{}(token);
+}
+
+void TokenFilter::sync()
+{
+    if (std::chrono::steady_clock::now() - m_lastRebuild >= m_settings.rebuildPeriod)
+    {
+        rebuild();
+        return;
+    }
+
+    const auto now = std::chrono::system_clock::now();
+    auto filter = m_filter.Read();
+    raiseSyncedMaxId(addSince(*filter->get(), m_lastSync));
+    m_lastSync = now;
+    m_syncedAt.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+}
+
+void TokenFilter::rebuild()
+{
+    const auto started = std::chrono::system_clock::now();
+    const auto rows = m_dbHelper.loadKeys(std::nullopt);
+
+    // Grown ahead of the table, so the false positive rate holds until the next rebuild
+    auto filter = std::make_unique<BloomFilter>(
+        std::max(m_settings.expectedItems, rows.size() * 2), m_settings.falsePositiveRate);
+    const auto loadedMaxId = addRows(*filter, rows);
+    m_filter.Assign(std::move(filter));
+
+    // Links saved while the table was read may have been added to the old filter only
+    const auto savedMaxId = addSince(*m_filter.Read()->get(), started);
+    raiseSyncedMaxId(std::max(loadedMaxId, savedMaxId));
+
+    m_lastSync = started;
+    m_lastRebuild = std::chrono::steady_clock::now();
+    m_syncedAt.store(m_lastRebuild.time_since_epoch().count(), std::memory_order_release);
+    m_rebuilds.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO() << "Token filter rebuilt from " << rows.size() << " links";
+}
+
+int64_t TokenFilter::addSince(BloomFilter& filter, const std::chrono::system_clock::time_point& since)
+{
+    const auto rows = m_dbHelper.loadKeys(
+        userver::storages::postgres::TimePointWithoutTz{since - SYNC_CORRECTION});
+    return addRows(filter, rows);
+}
+
+int64_t TokenFilter::addRows(BloomFilter& filter, const std::vector<LinkStoreRow>& rows)
+{
+    int64_t maxId = 0;
+    for (const auto& row : rows)
+    {
+        filter.add(hashOf(row.token, row.id));
+        const auto id = m_dbHelper.keyMode() == LinkStoreKey::id ? row.id : m_idDecoder(row.token).value_or(0);
+        maxId = std::max(maxId, id);
+    }
+    return maxId;
+}
+
+void TokenFilter::raiseSyncedMaxId(int64_t maxId)
+{
+    // Raised only once the links are in the filter in use, so a handler
+    // never trusts a negative for an id that is still being added
+    if (maxId > m_syncedMaxId.load(std::memory_order_relaxed))
+    {
+        m_syncedMaxId.store(maxId, std::memory_order_release);
+    }
+}
+
+void TokenFilter::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    const auto filter = m_filter.Read();
+    writer["items"] = static_cast<std::uint64_t>(filter->get()->itemsCount());
+    writer["bits"] = static_cast<std::uint64_t>(filter->get()->bitsCount());
+    writer["hashes"] = static_cast<std::uint64_t>(filter->get()->hashesCount());
+    writer["estimated-false-positive-rate"] = filter->get()->estimatedFalsePositiveRate();
+
+    const auto positives = m_positives.load();
+    const auto falsePositives = m_falsePositives.load();
+    const auto negatives = m_negatives.load();
+    writer["negatives"] = userver::utils::statistics::Rate{negatives};
+    writer["positives"] = userver::utils::statistics::Rate{positives};
+    writer["false-positives"] = userver::utils::statistics::Rate{falsePositives};
+    // Rejected tokens let through because the filter may not have synced them yet
+    writer["unsynced"] = userver::utils::statistics::Rate{m_unsynced.load()};
+    // Share of absent tokens the filter failed to reject
+    writer["observed-false-positive-rate"] = falsePositives + negatives == 0
+        ? 0.0
+        : static_cast<double>(falsePositives) / (falsePositives + negatives);
+    writer["rebuilds"] = userver::utils::statistics::Rate{m_rebuilds.load()};
+}
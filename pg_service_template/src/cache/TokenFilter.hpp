@@ -0,0 +1,105 @@
+#ifndef __TOKEN_FILTER_HPP__
+#define __TOKEN_FILTER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <userver/rcu/rcu.hpp>
+#include <userver/utils/periodic_task.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+#include "BloomFilter.hpp"
+#include "../db/DBHelper.hpp"
+
+/**
+ * Bloom filter over the keys of all links in linkstore. A negative answer
+ * means the link certainly does not exist, so GET can reply 404 without
+ * any database access. Links created by this instance are added right
+ * away, links of other instances are picked up by the periodic sync.
+ * Until then their ids are above the highest synced one, as ids are
+ * leased in increasing order, and such ids are let through to the
+ * database, as is every id while the sync keeps failing. The filter is
+ * rebuilt from scratch from time to time to shed deleted and expired links.
+ */
+class TokenFilter
+{
+public:
+    struct Settings
+    {
+        std::size_t expectedItems = 1000000;
+        double falsePositiveRate = 0.01;
+        std::chrono::milliseconds syncPeriod{1000};
+        std::chrono::seconds rebuildPeriod{3600};
+    };
+
+    /// Id encoded in a token, linkstore keyed by token stores no ids
+    using IdDecoder = std::function<std::optional<int64_t>(std::string_view token)>;
+
+    TokenFilter(const Settings& settings, const DBHelper& dbHelper, IdDecoder idDecoder,
+                userver::utils::statistics::Storage& statisticsStorage);
+    ~TokenFilter();
+
+    /// Loads all keys from the database and starts the background sync
+    void start();
+
+    /// Links are keyed by the token or by its id, depending on the LinkStoreKey mode
+    void add(std::string_view token, int64_t id);
+
+    bool mayContain(std::string_view token, int64_t id);
+
+    /// The filter let through a token that is not in the database
+    void reportFalsePositive();
+
+private:
+    // Rows of transactions that were still running during the previous
+    // sync carry an earlier create_time, so every sync overlaps a bit.
+    // create_time is UTC, as the system_clock times the syncs start at
+    static constexpr std::chrono::seconds SYNC_CORRECTION{5};
+
+    TokenFilter(const TokenFilter&) = delete;
+    TokenFilter& operator=(const TokenFilter&) = delete;
+
+    std::uint64_t hashOf(std::string_view token, int64_t id) const;
+
+    void sync();
+    void rebuild();
+    // Both return the highest id of the added links
+    int64_t addSince(BloomFilter& filter, const std::chrono::system_clock::time_point& since);
+    int64_t addRows(BloomFilter& filter, const std::vector<LinkStoreRow>& rows);
+    void raiseSyncedMaxId(int64_t maxId);
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    const DBHelper m_dbHelper;
+    const IdDecoder m_idDecoder;
+
+    userver::rcu::Variable<std::unique_ptr<BloomFilter>> m_filter;
+
+    // Only touched by the sync task
+    std::chrono::system_clock::time_point m_lastSync;
+    std::chrono::steady_clock::time_point m_lastRebuild;
+
+    // Highest id of the synced links and the end of the last successful
+    // sync, read by the handlers
+    std::atomic<int64_t> m_syncedMaxId{0};
+    std::atomic<std::chrono::steady_clock::rep> m_syncedAt{0};
+
+    std::atomic<std::uint64_t> m_negatives{0};
+    std::atomic<std::uint64_t> m_positives{0};
+    std::atomic<std::uint64_t> m_falsePositives{0};
+    std::atomic<std::uint64_t> m_unsynced{0};
+    std::atomic<std::uint64_t> m_rebuilds{0};
+
+    userver::utils::PeriodicTask m_syncTask;
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
@@ -1,13 +1,76 @@
 #include "DBCleaner.hpp"
 #include "../ConfigParameters.hpp"
+#include "../exceptions/DBException.hpp"
+#include "../exceptions/InternalException.hpp"
 
+#include <cstdlib>
 
-DBCleaner::DBCleaner(DBHelper& dbHelper)
-    : m_dbHelper(dbHelper){}
+#include <userver/logging/log.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+
+DBCleaner::DBCleaner(DBHelper& dbHelper, const Settings& settings,
+                     userver::utils::statistics::Storage& statisticsStorage)
+    : m_dbHelper(dbHelper), m_settings(settings)
+{
+  if (m_settings.batchSize == 0)
+  {
+    throw InternalLogicException("Cleaner batch size must be positive");
+  }
+
+  m_statisticsEntry = statisticsStorage.RegisterWriter(
+      "db-cleaner", [this](userver::utils::statistics::Writer& writer) {
+        writeStatistics(writer);
+      });
+}
+
+DBCleaner::~DBCleaner()
+{
+  m_statisticsEntry.Unregister();
+  m_cleaner.Stop();
+}
 
 void DBCleaner::CleanExpiredData() {
-  m_dbHelper.cleanExpiredData();
-  std::cout << "Cleaning expired data; " << std::endl;
+  const auto started = std::chrono::steady_clock::now();
+  m_runs.fetch_add(1, std::memory_order_relaxed);
+  try
+  {
+    m_dbHelper.prepareLinkPartitions();
+    const auto cleanup = m_dbHelper.cleanExpiredData(m_settings.batchSize, m_settings.timeBudget);
+    m_dbHelper.prepareLogPartitions();
+
+    m_rowsDeleted.fetch_add(cleanup.rowsDeleted, std::memory_order_relaxed);
+    m_batches.fetch_add(cleanup.batches, std::memory_order_relaxed);
+    m_partitionsDropped.fetch_add(cleanup.partitionsDropped, std::memory_order_relaxed);
+    m_lastRunRows = cleanup.rowsDeleted;
+    m_lastRunBatches = cleanup.batches;
+    if (!cleanup.finished)
+    {
+      m_unfinished.fetch_add(1, std::memory_order_relaxed);
+      LOG_WARNING() << "Expired links are left after " << cleanup.batches
+                    << " batches, the time budget ran out";
+    }
+  }
+  catch (const DBException& e)
+  {
+    m_failed.fetch_add(1, std::memory_order_relaxed);
+    LOG_ERROR() << e.what();
+  }
+  m_lastRunMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - started).count();
+}
+
+void DBCleaner::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+  writer["runs"] = userver::utils::statistics::Rate{m_runs.load()};
+  writer["failed"] = userver::utils::statistics::Rate{m_failed.load()};
+  writer["unfinished"] = userver::utils::statistics::Rate{m_unfinished.load()};
+  writer["rows-deleted"] = userver::utils::statistics::Rate{m_rowsDeleted.load()};
+  writer["batches"] = userver::utils::statistics::Rate{m_batches.load()};
+  writer["partitions-dropped"] = userver::utils::statistics::Rate{m_partitionsDropped.load()};
+  writer["last-run-rows"] = m_lastRunRows.load();
+  writer["last-run-batches"] = m_lastRunBatches.load();
+  writer["last-run-ms"] = m_lastRunMs.load();
 }
 
 int DBCleaner::getCleanPeriod() const
@@ -2,26 +2,56 @@
 #define __DB_CLEANER_HPP__
 
 #include <userver/utils/periodic_task.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include "DBHelper.hpp"
-#include <iostream>
 
 
 class DBCleaner
 {
+public:
+    struct Settings
+    {
+        // Rows deleted per statement
+        std::size_t batchSize = 5000;
+        // A run stops deleting after it, the rest is left to the next run
+        std::chrono::milliseconds timeBudget{5000};
+    };
+
 private:
 
     userver::utils::PeriodicTask m_cleaner;
     DBHelper m_dbHelper;
+    const Settings m_settings;
     inline static const std::chrono::seconds DEFAULT_CLEAN_PERIOD = std::chrono::seconds(10);//(10);
+
+    std::atomic<std::uint64_t> m_runs{0};
+    std::atomic<std::uint64_t> m_failed{0};
+    std::atomic<std::uint64_t> m_unfinished{0};
+    std::atomic<std::uint64_t> m_rowsDeleted{0};
+    std::atomic<std::uint64_t> m_batches{0};
+    std::atomic<std::uint64_t> m_partitionsDropped{0};
+    std::atomic<std::uint64_t> m_lastRunRows{0};
+    std::atomic<std::uint64_t> m_lastRunBatches{0};
+    std::atomic<std::int64_t> m_lastRunMs{0};
+    userver::utils::statistics::Entry m_statisticsEntry;
+
     void CleanExpiredData();
 
     int getCleanPeriod() const;
 
     void resetSettings();
 
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
 public:
-    DBCleaner(DBHelper& dbHelper);
+    DBCleaner(DBHelper& dbHelper, const Settings& settings,
+              userver::utils::statistics::Storage& statisticsStorage);
+    ~DBCleaner();
 
     
     void start();
@@ -29,4 +59,4 @@ public:
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -3,6 +3,113 @@
 #include "../exceptions/InternalException.hpp"
 #include "../ConfigParameters.hpp"
 
+#include <userver/crypto/hash.hpp>
+#include <userver/storages/postgres/io/bytea.hpp>
+#include <userver/logging/log.hpp>
+#include <userver/utils/datetime.hpp>
+
+#include <algorithm>
+#include <tuple>
+
+#include <fmt/format.h>
+
+namespace {
+
+// link, the seconds left until expires_at, null for a link that never
+// expires, and response_mode
+using LongUrlInfoRow = std::tuple<std::string, std::optional<int64_t>, std::optional<int16_t>>;
+
+LongUrlInfo toLongUrlInfo(const LongUrlInfoRow& row)
+{
+  LongUrlInfo info{std::get<0>(row), std::nullopt, std::nullopt};
+  const auto& secondsLeft = std::get<1>(row);
+  if (secondsLeft.has_value())
+  {
+    info.timeToLive = std::chrono::seconds(std::max<int64_t>(secondsLeft.value(), 0));
+  }
+  const auto& responseMode = std::get<2>(row);
+  if (responseMode.has_value())
+  {
+    info.responseMode = static_cast<ResponseMode>(responseMode.value());
+  }
+  return info;
+}
+
+// token, id, then the columns of LongUrlInfoRow
+using ResolvedLinkRow = std::tuple<std::string, int64_t, std::string, std::optional<int64_t>, std::optional<int16_t>>;
+
+std::vector<ResolvedLink> toResolvedLinks(const userver::storages::postgres::ResultSet& res)
+{
+  std::vector<ResolvedLink> links;
+  links.reserve(res.Size());
+  for (const auto& row : res.AsSetOf<ResolvedLinkRow>(userver::storages::postgres::kRowTag))
+  {
+    links.push_back(ResolvedLink{
+        std::get<0>(row), std::get<1>(row),
+        toLongUrlInfo(LongUrlInfoRow{std::get<2>(row), std::get<3>(row), std::get<4>(row)})});
+  }
+  return links;
+}
+
+std::optional<int> timeToLiveSeconds(const LinkOptions& options)
+{
+  if (!options.timeToLive.has_value())
+  {
+    return std::nullopt;
+  }
+  return static_cast<int>(options.timeToLive->count());
+}
+
+std::optional<int16_t> responseModeCode(const LinkOptions& options)
+{
+  if (!options.responseMode.has_value())
+  {
+    return std::nullopt;
+  }
+  return static_cast<int16_t>(options.responseMode.value());
+}
+
+std::optional<std::string> deletedDigest(const userver::storages::postgres::ResultSet& res)
+{
+  if (res.IsEmpty())
+  {
+    return std::nullopt;
+  }
+  std::string digest;
+  res.Front()[0].To(userver::storages::postgres::Bytea(digest));
+  return digest;
+}
+
+// Seconds a link has left, by the database clock expires_at is written with
+const std::string SECONDS_LEFT = "extract(epoch from (expires_at - localtimestamp))::bigint";
+
+// Expiry of a link inserted now: the given time to live in seconds or the
+// expired_token_timestamp setting, whose name is $4. Null for neither
+std::string expiresAt(const std::string& timeToLive)
+{
+  return "current_timestamp + make_interval(secs => coalesce(" + timeToLive + ", "
+         "(select nullif(nullif(value, '')::int, 0) from service_settings where name = $4)))";
+}
+
+// date_trunc() unit and length of a linkstore partition
+std::string partitionUnit(const LinkStorePartitioning partitioning)
+{
+  return partitioning == LinkStorePartitioning::hourly ? "hour" : "day";
+}
+
+std::string partitionInterval(const LinkStorePartitioning partitioning)
+{
+  return "1 " + partitionUnit(partitioning);
+}
+
+}  // namespace
+
+std::string DBHelper::linkDigest(const std::string& longUrl)
+{
+  return userver::crypto::hash::Sha256(longUrl, userver::crypto::hash::OutputEncoding::kBinary)
+      .substr(0, LINK_DIGEST_SIZE);
+}
+
 void DBHelper::prepareDB(const bool needReCreate /*= false*/) {
   try
   {
@@ -13,11 +120,63 @@ void DBHelper::prepareDB(const bool needReCreate /*= false*/) {
                           dropTableQuery);
     }
 
-    const userver::storages::postgres::Query createTableQuery{
-        CREATE_LISKSTORE,
-        userver::storages::postgres::Query::Name{"create table LISKSTORE"}};
+    if (m_partitioning == LinkStorePartitioning::none)
+    {
+      const userver::storages::postgres::Query createTableQuery{
+          m_keyMode == LinkStoreKey::id ? CREATE_LISKSTORE_BY_ID : CREATE_LISKSTORE,
+          userver::storages::postgres::Query::Name{"create table LISKSTORE"}};
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                          createTableQuery);
+    }
+    else
+    {
+      const userver::storages::postgres::Query createTableQuery{
+          fmt::format(CREATE_LISKSTORE_PARTITIONED,
+                      fmt::arg("key", m_keyMode == LinkStoreKey::id ? "id bigint" : "token varchar(200)"),
+                      fmt::arg("key_name", m_keyMode == LinkStoreKey::id ? "id" : "token"),
+                      fmt::arg("unit", partitionUnit(m_partitioning))),
+          userver::storages::postgres::Query::Name{"create partitioned table LISKSTORE"}};
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                          createTableQuery);
+
+      // Catches the rows of a period whose partition was not created in time
+      const userver::storages::postgres::Query createDefaultPartitionQuery{
+          CREATE_LISKSTORE_DEFAULT,
+          userver::storages::postgres::Query::Name{"create table LISKSTORE default"}};
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                          createDefaultPartitionQuery);
+    }
+
+    const userver::storages::postgres::Query createCreateTimeIndexQuery{
+        CREATE_LISKSTORE_CREATE_TIME_INDEX,
+        userver::storages::postgres::Query::Name{"create index LISKSTORE create_time"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        createCreateTimeIndexQuery);
+
+    const userver::storages::postgres::Query createExpiresAtIndexQuery{
+        CREATE_LISKSTORE_EXPIRES_AT_INDEX,
+        userver::storages::postgres::Query::Name{"create index LISKSTORE expires_at"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        createExpiresAtIndexQuery);
+
+    if (needReCreate) {
+      const userver::storages::postgres::Query dropTableTombstoneQuery{
+          DROP_LISKSTORE_TOMBSTONE, userver::storages::postgres::Query::Name{"drop table LISKSTORE_TOMBSTONE"}};
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                          dropTableTombstoneQuery);
+    }
+
+    const userver::storages::postgres::Query createTableTombstoneQuery{
+        CREATE_LISKSTORE_TOMBSTONE,
+        userver::storages::postgres::Query::Name{"create table LISKSTORE_TOMBSTONE"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        createTableTombstoneQuery);
+
+    const userver::storages::postgres::Query createTombstoneIndexQuery{
+        CREATE_LISKSTORE_TOMBSTONE_INDEX,
+        userver::storages::postgres::Query::Name{"create index LISKSTORE_TOMBSTONE delete_time"}};
     m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
-                        createTableQuery);
+                        createTombstoneIndexQuery);
 
     if (needReCreate) {
       const userver::storages::postgres::Query dropTableLinkRetryQuery{
@@ -31,12 +190,113 @@ void DBHelper::prepareDB(const bool needReCreate /*= false*/) {
         userver::storages::postgres::Query::Name{"create table LINKLOGGER"}};
     m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
                         createTableLinkRetryQuery);
+
+    const userver::storages::postgres::Query createTableLinkRetryDefaultQuery{
+        CREATE_LISKSTORELOGGER_DEFAULT,
+        userver::storages::postgres::Query::Name{"create table LINKLOGGER default"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        createTableLinkRetryDefaultQuery);
+
+    const userver::storages::postgres::Query createLinkRetryIndexQuery{
+        CREATE_LISKSTORELOGGER_INDEX,
+        userver::storages::postgres::Query::Name{"create index LINKLOGGER request_time"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        createLinkRetryIndexQuery);
+
+    // The id counter is never dropped: ids must stay unique across restarts
+    const userver::storages::postgres::Query createTableIdLeaseQuery{
+        CREATE_ID_LEASE,
+        userver::storages::postgres::Query::Name{"create table ID_LEASE"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        createTableIdLeaseQuery);
+
+    const userver::storages::postgres::Query initIdLeaseQuery{
+        INIT_ID_LEASE,
+        userver::storages::postgres::Query::Name{"init ID_LEASE"}};
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        initIdLeaseQuery);
   }
   catch(const std::exception& e)
   {
     const std::string errorMess = std::string("Cannot prepare tables.") + e.what();
     throw DBException(errorMess.c_str());
   }
+  prepareLinkPartitions();
+  prepareLogPartitions();
+}
+
+void DBHelper::prepareLinkPartitions() const {
+  if (m_partitioning == LinkStorePartitioning::none)
+  {
+    return;
+  }
+
+  // Periods are computed by the database clock, the one create_period uses
+  using PartitionRow = std::tuple<std::string, std::string, std::string>;
+  std::vector<PartitionRow> partitions;
+  try
+  {
+    const userver::storages::postgres::Query kLinkPartitions{
+        "select to_char(p, 'YYYYMMDDHH24'), p::text, (p + $2::interval)::text "
+        "from generate_series(date_trunc($1, localtimestamp), localtimestamp + $3::interval, $2::interval) p",
+        userver::storages::postgres::Query::Name{"link_partitions_ahead"},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kLinkPartitions, partitionUnit(m_partitioning),
+                            partitionInterval(m_partitioning), LINK_PARTITIONS_AHEAD);
+    partitions = res.AsContainer<std::vector<PartitionRow>>(userver::storages::postgres::kRowTag);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot plan linkstore partitions.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+
+  for (const auto& [suffix, from, to] : partitions)
+  {
+    const auto name = "linkstore_p" + suffix;
+    try
+    {
+      const userver::storages::postgres::Query createPartitionQuery{
+          "create table if not exists " + name + " partition of linkstore for values from ('" +
+          from + "') to ('" + to + "');"};
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                          createPartitionQuery);
+    }
+    catch(const std::exception& e)
+    {
+      // Fails when the default partition already holds rows of that period
+      LOG_WARNING() << "Cannot create linkstore partition " << name << ": " << e.what();
+    }
+  }
+}
+
+void DBHelper::prepareLogPartitions() const {
+  // Partitions are cut at UTC midnight, request times are stored in UTC
+  const auto today = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+  for (int day = 0; day <= LOG_PARTITIONS_AHEAD_DAYS; ++day)
+  {
+    const auto from = today + std::chrono::days(day);
+    const auto to = from + std::chrono::days(1);
+    const auto name = "linkstorelogger_" + userver::utils::datetime::Timestring(from, "UTC", "%Y%m%d");
+    try
+    {
+      // DDL takes no parameters, the bounds are formatted from the clock only
+      const userver::storages::postgres::Query createPartitionQuery{
+          "create table if not exists " + name + " partition of linkstorelogger for values from ('" +
+          userver::utils::datetime::Timestring(from, "UTC", "%Y-%m-%d") + "') to ('" +
+          userver::utils::datetime::Timestring(to, "UTC", "%Y-%m-%d") + "');"};
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                          createPartitionQuery);
+    }
+    catch(const std::exception& e)
+    {
+      // Fails when the default partition already holds rows of that day,
+      // they stay there and the next days are still split off
+      LOG_WARNING() << "Cannot create log partition " << name << ": " << e.what();
+    }
+  }
 }
 
 void DBHelper::prepareSettingsTable(const bool needReCreate /*= false*/) const {
@@ -62,24 +322,69 @@ void DBHelper::prepareSettingsTable(const bool needReCreate /*= false*/) const {
   }
 }
 
-void DBHelper::saveTokenInfo(const std::string& token, const std::string& longUrl) const {
+StoredLink DBHelper::shortenUrl(const std::string& token, const std::string& longUrl,
+                                const LinkOptions& options) const {
   if (token.empty()) {
     throw InternalLogicException("Cannot save token info: Internal error. Long link's token is empty");
   }
   try
   {
-    userver::storages::postgres::Transaction transaction = m_pg_cluster->Begin(
-        "transaction_insert_link_with_token_info",
-        userver::storages::postgres::ClusterHostType::kMaster, {});
+    // The no-op update makes RETURNING yield the row of a concurrent or
+    // earlier insert of the same url, xmax is only zero for a fresh row.
+    // An expired link not deleted yet gets the expiry and the options of the
+    // new one, a live one keeps its own and returns them for comparison
+    const userver::storages::postgres::Query kShortenValue{
+        "INSERT INTO linkstore (token, link, link_digest, create_time, ttl_seconds, sliding, response_mode, expires_at) "
+        "VALUES ($1, $2, $3, timezone('UTC', now()), $5, $6, $7, " + expiresAt("$5::integer") + ") "
+        "ON CONFLICT ON CONSTRAINT linkstore_link_digest_key DO UPDATE SET link_digest = excluded.link_digest, "
+        "ttl_seconds = case when linkstore.expires_at <= localtimestamp then excluded.ttl_seconds else linkstore.ttl_seconds end, "
+        "sliding = case when linkstore.expires_at <= localtimestamp then excluded.sliding else linkstore.sliding end, "
+        "response_mode = case when linkstore.expires_at <= localtimestamp then excluded.response_mode else linkstore.response_mode end, "
+        "expires_at = case when linkstore.expires_at <= localtimestamp then excluded.expires_at else linkstore.expires_at end "
+        "RETURNING token, 0::bigint, (xmax = 0) AS inserted, ttl_seconds, sliding, response_mode",
+        userver::storages::postgres::Query::Name{"shorten_link_with_token"},
+    };
+    const auto digest = linkDigest(longUrl);
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kShortenValue, token, longUrl,
+                            userver::storages::postgres::Bytea(digest),
+                            ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp),
+                            timeToLiveSeconds(options), options.sliding,
+                            responseModeCode(options));
+    return res.AsSingleRow<StoredLink>(userver::storages::postgres::kRowTag);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot register long url into database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
 
-    const userver::storages::postgres::Query kInsertValue{
-        "INSERT INTO linkstore (token, link, create_time) "
-        "VALUES ($1, $2, current_timestamp) "
-        "ON CONFLICT DO NOTHING",
-        userver::storages::postgres::Query::Name{"insert_value_link_with_token"},
+StoredLink DBHelper::shortenUrl(const int64_t id, const std::string& longUrl,
+                                const LinkOptions& options) const {
+  try
+  {
+    const userver::storages::postgres::Query kShortenValue{
+        "INSERT INTO linkstore (id, link, link_digest, create_time, ttl_seconds, sliding, response_mode, expires_at) "
+        "VALUES ($1, $2, $3, timezone('UTC', now()), $5, $6, $7, " + expiresAt("$5::integer") + ") "
+        "ON CONFLICT ON CONSTRAINT linkstore_link_digest_key DO UPDATE SET link_digest = excluded.link_digest, "
+        "ttl_seconds = case when linkstore.expires_at <= localtimestamp then excluded.ttl_seconds else linkstore.ttl_seconds end, "
+        "sliding = case when linkstore.expires_at <= localtimestamp then excluded.sliding else linkstore.sliding end, "
+        "response_mode = case when linkstore.expires_at <= localtimestamp then excluded.response_mode else linkstore.response_mode end, "
+        "expires_at = case when linkstore.expires_at <= localtimestamp then excluded.expires_at else linkstore.expires_at end "
+        "RETURNING ''::text, id, (xmax = 0) AS inserted, ttl_seconds, sliding, response_mode",
+        userver::storages::postgres::Query::Name{"shorten_link_with_id"},
     };
-    transaction.Execute(kInsertValue, token, longUrl);
-    transaction.Commit();
+    const auto digest = linkDigest(longUrl);
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kShortenValue, id, longUrl,
+                            userver::storages::postgres::Bytea(digest),
+                            ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp),
+                            timeToLiveSeconds(options), options.sliding,
+                            responseModeCode(options));
+    return res.AsSingleRow<StoredLink>(userver::storages::postgres::kRowTag);
   }
   catch(const std::exception& e)
   {
@@ -88,26 +393,83 @@ void DBHelper::saveTokenInfo(const std::string& token, const std::string& longUr
   }
 }
 
-std::optional<std::string> DBHelper::findToken(const std::string& longUrl) const {
+std::vector<DigestLink> DBHelper::findLinks(const std::vector<std::string>& digests) const {
   try
   {
-    const userver::storages::postgres::Query kFindTokenValue{
-        "select token from linkstore where link = $1",
+    const userver::storages::postgres::Query kFindLinks{
+        m_keyMode == LinkStoreKey::id
+          ? "select distinct on (link_digest) encode(link_digest, 'hex'), ''::text, id, false from linkstore "
+            "where link_digest = ANY(array(select decode(d, 'hex') from unnest($1::text[]) as d)) "
+            "order by link_digest, create_time desc"
+          : "select distinct on (link_digest) encode(link_digest, 'hex'), token, 0::bigint, false from linkstore "
+            "where link_digest = ANY(array(select decode(d, 'hex') from unnest($1::text[]) as d)) "
+            "order by link_digest, create_time desc",
         userver::storages::postgres::Query::Name{
-            "try_find_token_by_long_url_value"},
+            m_keyMode == LinkStoreKey::id ? "find_links_with_id_by_digests" : "find_links_by_digests"},
     };
 
     const auto res =
         m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
-                            kFindTokenValue, longUrl);
-    if (!res.IsEmpty()) {
-      return std::string{res.AsSingleRow<std::string>()};
+                            kFindLinks, digests);
+    return res.AsContainer<std::vector<DigestLink>>(userver::storages::postgres::kRowTag);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot find tokens of long urls from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::vector<DigestLink> DBHelper::shortenUrls(
+  const std::vector<std::string>& tokens,
+  const std::vector<int64_t>& ids,
+  const std::vector<std::string>& longUrls,
+  const std::vector<std::string>& digests) const
+{
+  try
+  {
+    if (m_keyMode == LinkStoreKey::id)
+    {
+      const userver::storages::postgres::Query kShortenValues{
+          "INSERT INTO linkstore (id, link, link_digest, create_time, expires_at) "
+          "SELECT id, link, decode(digest, 'hex'), timezone('UTC', now()), " + expiresAt("null::integer") + " "
+          "FROM unnest($1::bigint[], $2::text[], $3::text[]) AS t(id, link, digest) "
+          "ON CONFLICT ON CONSTRAINT linkstore_link_digest_key DO UPDATE SET link_digest = excluded.link_digest, "
+          "ttl_seconds = case when linkstore.expires_at <= localtimestamp then excluded.ttl_seconds else linkstore.ttl_seconds end, "
+          "sliding = case when linkstore.expires_at <= localtimestamp then excluded.sliding else linkstore.sliding end, "
+          "response_mode = case when linkstore.expires_at <= localtimestamp then excluded.response_mode else linkstore.response_mode end, "
+          "expires_at = case when linkstore.expires_at <= localtimestamp then excluded.expires_at else linkstore.expires_at end "
+          "RETURNING encode(link_digest, 'hex'), ''::text, id, (xmax = 0) AS inserted",
+          userver::storages::postgres::Query::Name{"shorten_links_with_id"},
+      };
+      const auto res =
+          m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                              kShortenValues, ids, longUrls, digests,
+                              ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp));
+      return res.AsContainer<std::vector<DigestLink>>(userver::storages::postgres::kRowTag);
     }
-    return std::nullopt;
+
+    const userver::storages::postgres::Query kShortenValues{
+        "INSERT INTO linkstore (token, link, link_digest, create_time, expires_at) "
+        "SELECT token, link, decode(digest, 'hex'), timezone('UTC', now()), " + expiresAt("null::integer") + " "
+        "FROM unnest($1::text[], $2::text[], $3::text[]) AS t(token, link, digest) "
+        "ON CONFLICT ON CONSTRAINT linkstore_link_digest_key DO UPDATE SET link_digest = excluded.link_digest, "
+        "ttl_seconds = case when linkstore.expires_at <= localtimestamp then excluded.ttl_seconds else linkstore.ttl_seconds end, "
+        "sliding = case when linkstore.expires_at <= localtimestamp then excluded.sliding else linkstore.sliding end, "
+        "response_mode = case when linkstore.expires_at <= localtimestamp then excluded.response_mode else linkstore.response_mode end, "
+        "expires_at = case when linkstore.expires_at <= localtimestamp then excluded.expires_at else linkstore.expires_at end "
+        "RETURNING encode(link_digest, 'hex'), token, 0::bigint, (xmax = 0) AS inserted",
+        userver::storages::postgres::Query::Name{"shorten_links_with_token"},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kShortenValues, tokens, longUrls, digests,
+                            ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp));
+    return res.AsContainer<std::vector<DigestLink>>(userver::storages::postgres::kRowTag);
   }
   catch(const std::exception& e)
   {
-    const std::string errorMess = std::string("Cannot find token of long url from database.") + e.what();
+    const std::string errorMess = std::string("Cannot register long urls into database.") + e.what();
     throw DBException(errorMess.c_str());
   }
 }
@@ -116,7 +478,8 @@ std::string DBHelper::getLongUrl(const std::string& token) const {
   try
   {
     const userver::storages::postgres::Query kFindTokenValue{
-        "select link from linkstore where token = $1",
+        "select link from linkstore where token = $1 "
+        "and (expires_at is null or expires_at > localtimestamp)",
         userver::storages::postgres::Query::Name{
             "try_find_long_url_by_token_value"},
     };
@@ -136,7 +499,260 @@ std::string DBHelper::getLongUrl(const std::string& token) const {
   }
 }
 
-void DBHelper::deleteLongUrlInfo(const std::string& token) const
+std::optional<LongUrlInfo> DBHelper::getLongUrlInfo(const std::string& token) const {
+  try
+  {
+    const userver::storages::postgres::Query kFindTokenInfoValue{
+        "select link, "
+        "extract(epoch from (expires_at - localtimestamp))::bigint, response_mode "
+        "from linkstore where token = $1 "
+        "and (expires_at is null or expires_at > localtimestamp)",
+        userver::storages::postgres::Query::Name{
+            "try_find_long_url_info_by_token_value"},
+    };
+
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
+                            kFindTokenInfoValue, token);
+    if (!res.IsEmpty()) {
+      return toLongUrlInfo(res.AsSingleRow<LongUrlInfoRow>(userver::storages::postgres::kRowTag));
+    }
+    return std::nullopt;
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot find long url from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::optional<LongUrlInfo> DBHelper::getLongUrlInfo(const int64_t id) const {
+  try
+  {
+    const userver::storages::postgres::Query kFindIdInfoValue{
+        "select link, "
+        "extract(epoch from (expires_at - localtimestamp))::bigint, response_mode "
+        "from linkstore where id = $1 "
+        "and (expires_at is null or expires_at > localtimestamp)",
+        userver::storages::postgres::Query::Name{
+            "try_find_long_url_info_by_id_value"},
+    };
+
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
+                            kFindIdInfoValue, id);
+    if (!res.IsEmpty()) {
+      return toLongUrlInfo(res.AsSingleRow<LongUrlInfoRow>(userver::storages::postgres::kRowTag));
+    }
+    return std::nullopt;
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot find long url from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::vector<ResolvedLink> DBHelper::getLongUrlInfos(const std::vector<std::string>& tokens) const {
+  try
+  {
+    const userver::storages::postgres::Query kFindTokensInfoValue{
+        "select token, 0::bigint, link, "
+        "extract(epoch from (expires_at - localtimestamp))::bigint, response_mode "
+        "from linkstore where token = ANY($1) "
+        "and (expires_at is null or expires_at > localtimestamp)",
+        userver::storages::postgres::Query::Name{
+            "find_long_urls_info_by_tokens"},
+    };
+
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
+                            kFindTokensInfoValue, tokens);
+    return toResolvedLinks(res);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot find long urls from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::vector<ResolvedLink> DBHelper::getLongUrlInfos(const std::vector<int64_t>& ids) const {
+  try
+  {
+    const userver::storages::postgres::Query kFindIdsInfoValue{
+        "select ''::text, id, link, "
+        "extract(epoch from (expires_at - localtimestamp))::bigint, response_mode "
+        "from linkstore where id = ANY($1) "
+        "and (expires_at is null or expires_at > localtimestamp)",
+        userver::storages::postgres::Query::Name{
+            "find_long_urls_info_by_ids"},
+    };
+
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
+                            kFindIdsInfoValue, ids);
+    return toResolvedLinks(res);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot find long urls from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::vector<LinkStoreRow> DBHelper::loadLinks(
+  const std::optional<userver::storages::postgres::TimePointWithoutTz>& since) const
+{
+  try
+  {
+    return m_keyMode == LinkStoreKey::id
+      ? loadRows("select ''::text, id, link, response_mode, " + SECONDS_LEFT + " from linkstore", "load_links_with_id", since)
+      : loadRows("select token, 0::bigint, link, response_mode, " + SECONDS_LEFT + " from linkstore", "load_links", since);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot load links from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::vector<LinkStoreRow> DBHelper::loadKeys(
+  const std::optional<userver::storages::postgres::TimePointWithoutTz>& since) const
+{
+  try
+  {
+    return m_keyMode == LinkStoreKey::id
+      ? loadRows("select ''::text, id, ''::text, null::smallint, null::bigint from linkstore", "load_keys_with_id", since)
+      : loadRows("select token, 0::bigint, ''::text, null::smallint, null::bigint from linkstore", "load_keys", since);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot load link keys from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::vector<LinkStoreRow> DBHelper::loadRows(
+  const std::string& select, const std::string& name,
+  const std::optional<userver::storages::postgres::TimePointWithoutTz>& since) const
+{
+  if (!since.has_value())
+  {
+    const userver::storages::postgres::Query kLoadAll{
+        select,
+        userver::storages::postgres::Query::Name{"all_" + name},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave, kLoadAll);
+    return res.AsContainer<std::vector<LinkStoreRow>>(userver::storages::postgres::kRowTag);
+  }
+
+  const userver::storages::postgres::Query kLoadSince{
+      select + " where create_time >= $1",
+      userver::storages::postgres::Query::Name{"new_" + name},
+  };
+  const auto res =
+      m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
+                          kLoadSince, since.value());
+  return res.AsContainer<std::vector<LinkStoreRow>>(userver::storages::postgres::kRowTag);
+}
+
+std::vector<LinkStoreRow> DBHelper::loadTombstones(
+  const userver::storages::postgres::TimePointWithoutTz& since) const
+{
+  try
+  {
+    const userver::storages::postgres::Query kLoadTombstones{
+        "select coalesce(token, ''), coalesce(id, 0), ''::text, null::smallint, null::bigint "
+        "from linkstore_tombstone where delete_time >= $1",
+        userver::storages::postgres::Query::Name{"load_tombstones"},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kSlave,
+                            kLoadTombstones, since);
+    return res.AsContainer<std::vector<LinkStoreRow>>(userver::storages::postgres::kRowTag);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot load deleted links from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::size_t DBHelper::touchLinks(const std::vector<std::string>& tokens) const {
+  try
+  {
+    const userver::storages::postgres::Query kTouchTokens{
+        "update linkstore set expires_at = localtimestamp + make_interval(secs => coalesce(ttl_seconds, "
+        "(select nullif(nullif(value, '')::int, 0) from service_settings where name = $2))) "
+        "where token = ANY($1) and sliding and expires_at > localtimestamp",
+        userver::storages::postgres::Query::Name{"touch_sliding_links_by_tokens"},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kTouchTokens, tokens,
+                            ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp));
+    return res.RowsAffected();
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot extend sliding links in database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::size_t DBHelper::touchLinks(const std::vector<int64_t>& ids) const {
+  try
+  {
+    const userver::storages::postgres::Query kTouchIds{
+        "update linkstore set expires_at = localtimestamp + make_interval(secs => coalesce(ttl_seconds, "
+        "(select nullif(nullif(value, '')::int, 0) from service_settings where name = $2))) "
+        "where id = ANY($1) and sliding and expires_at > localtimestamp",
+        userver::storages::postgres::Query::Name{"touch_sliding_links_by_ids"},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kTouchIds, ids,
+                            ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp));
+    return res.RowsAffected();
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot extend sliding links in database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+int64_t DBHelper::leaseIdBlock(const int64_t blockSize) const
+{
+  if (blockSize <= 0)
+  {
+    throw InternalLogicException("Cannot lease id block: Internal error. Block size must be positive");
+  }
+  try
+  {
+    // A single statement is atomic, so concurrent replicas get disjoint ranges
+    const userver::storages::postgres::Query kLeaseIdBlock{
+        "update id_lease set next_id = next_id + $1 "
+        "where name = 'linkstore' "
+        "returning next_id - $1",
+        userver::storages::postgres::Query::Name{"lease_id_block"},
+    };
+
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kLeaseIdBlock, blockSize);
+    return res.AsSingleRow<int64_t>();
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot lease id block from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+std::optional<std::string> DBHelper::deleteLongUrlInfo(const std::string& token) const
 {
   if (token.empty())
   {
@@ -149,12 +765,16 @@ void DBHelper::deleteLongUrlInfo(const std::string& token) const
         userver::storages::postgres::ClusterHostType::kMaster, {});
 
     const userver::storages::postgres::Query kDeleteValue{
-        "Delete from linkstore where token = $1 ",
+        "with deleted as (Delete from linkstore where token = $1 returning token, link_digest), "
+        "tombstone as (insert into linkstore_tombstone (token, delete_time) "
+        "select token, timezone('UTC', now()) from deleted) "
+        "select link_digest from deleted",
         userver::storages::postgres::Query::Name{
             "delete_value_link_with_token"},
     };
     const auto deleteRes = transaction.Execute(kDeleteValue, token);
     transaction.Commit();
+    return deletedDigest(deleteRes);
   }
   catch (const std::exception& e)
   {
@@ -163,34 +783,169 @@ void DBHelper::deleteLongUrlInfo(const std::string& token) const
   }
 }
 
-void DBHelper::cleanExpiredData()
+std::optional<std::string> DBHelper::deleteLongUrlInfo(const int64_t id) const
 {
-  const std::string expiredTimestampParameter 
-    = ConfigParametersMap.at(ConfigParametersEnum::expired_token_timestamp);
-  const int value = std::atoi(getSettingValue(expiredTimestampParameter).c_str());
-  if (value == std::chrono::seconds(0).count())
-  {
-    LOG_WARNING() << "Ignored cleaning expired data becuase expired_timestamp was undefined";
-    return;
-  }
   try
   {
     userver::storages::postgres::Transaction transaction = m_pg_cluster->Begin(
-        "sample_transaction_delete_expired",
+        "sample_transaction_delete_longlink_by_id_value",
         userver::storages::postgres::ClusterHostType::kMaster, {});
 
     const userver::storages::postgres::Query kDeleteValue{
-        "delete from linkstore where extract(epoch from (current_timestamp - create_time)) >= $1 ",
-        userver::storages::postgres::Query::Name{"delete_expired_value" },
+        "with deleted as (Delete from linkstore where id = $1 returning id, link_digest), "
+        "tombstone as (insert into linkstore_tombstone (id, delete_time) "
+        "select id, timezone('UTC', now()) from deleted) "
+        "select link_digest from deleted",
+        userver::storages::postgres::Query::Name{
+            "delete_value_link_with_id"},
     };
-    transaction.Execute(kDeleteValue, value);
+    const auto deleteRes = transaction.Execute(kDeleteValue, id);
     transaction.Commit();
+    return deletedDigest(deleteRes);
+  }
+  catch (const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot clear data about long url from database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
+
+ExpiredCleanup DBHelper::cleanExpiredData(const std::size_t batchSize,
+                                          const std::chrono::milliseconds timeBudget)
+{
+  if (batchSize == 0)
+  {
+    throw InternalLogicException("Cannot clear expired data: Internal error. Batch size must be positive");
+  }
+  const auto deadline = std::chrono::steady_clock::now() + timeBudget;
+  ExpiredCleanup cleanup;
+
+  if (m_partitioning != LinkStorePartitioning::none)
+  {
+    cleanup.partitionsDropped = dropExpiredPartitions();
+  }
+
+  try
+  {
+    // A partitioned linkstore only deletes rows from the default partition,
+    // which is empty as long as the partitions are created ahead.
+    // Each batch commits on its own, so row locks are held for one batch only
+    const bool partitioned = m_partitioning != LinkStorePartitioning::none;
+    const std::string table = partitioned ? "linkstore_default" : "linkstore";
+    const std::string key = m_keyMode == LinkStoreKey::id ? "id" : "token";
+    const userver::storages::postgres::Query kDeleteValues{
+        "with deleted as (delete from " + table + " where ctid = any(array("
+        "select ctid from " + table + " where expires_at <= localtimestamp limit $1)) returning " + key + ") "
+        "insert into linkstore_tombstone (" + key + ", delete_time) select " + key + ", timezone('UTC', now()) from deleted",
+        userver::storages::postgres::Query::Name{
+          std::string(m_keyMode == LinkStoreKey::id ? "delete_expired_values_with_id" : "delete_expired_values") +
+          (partitioned ? "_from_default" : "") },
+    };
+    while (true)
+    {
+      const auto res =
+          m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                              kDeleteValues, static_cast<int64_t>(batchSize));
+      const auto deleted = res.RowsAffected();
+      ++cleanup.batches;
+      cleanup.rowsDeleted += deleted;
+      if (deleted < batchSize)
+      {
+        break;
+      }
+      if (std::chrono::steady_clock::now() >= deadline)
+      {
+        cleanup.finished = false;
+        break;
+      }
+    }
+
+    const userver::storages::postgres::Query kDeleteTombstones{
+        "delete from linkstore_tombstone where delete_time < timezone('UTC', now()) - make_interval(secs => $1)",
+        userver::storages::postgres::Query::Name{"delete_old_tombstones" },
+    };
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        kDeleteTombstones,
+                        static_cast<double>(std::chrono::seconds(TOMBSTONE_RETENTION).count()));
   }
   catch (const std::exception& e)
   {
     const std::string errorMess = std::string("Cannot clear expired data from database.") + e.what();
     throw DBException(errorMess.c_str());
   }
+  return cleanup;
+}
+
+std::uint64_t DBHelper::dropExpiredPartitions() const
+{
+  std::vector<std::string> ended;
+  try
+  {
+    // Partitions are named after their period start, see prepareLinkPartitions()
+    const userver::storages::postgres::Query kEndedPartitions{
+        "select c.relname::text from pg_inherits i join pg_class c on c.oid = i.inhrelid "
+        "where i.inhparent = 'linkstore'::regclass and c.relname ~ '^linkstore_p[0-9]{10}$' "
+        "and to_timestamp(substr(c.relname, 12), 'YYYYMMDDHH24')::timestamp + $1::interval <= localtimestamp "
+        "order by c.relname",
+        userver::storages::postgres::Query::Name{"find_ended_link_partitions"},
+    };
+    const auto res =
+        m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                            kEndedPartitions, partitionInterval(m_partitioning));
+    ended = res.AsContainer<std::vector<std::string>>();
+  }
+  catch(const std::exception& e)
+  {
+    LOG_WARNING() << "Cannot find expired linkstore partitions: " << e.what();
+    return 0;
+  }
+
+  std::uint64_t dropped = 0;
+  for (const auto& name : ended)
+  {
+    try
+    {
+      // Probed before the detach, which locks linkstore, so a partition
+      // still holding a live or never expiring link costs one scan per run.
+      // Expired links are never extended, a dead partition stays dead
+      const auto live = m_pg_cluster->Execute(
+          userver::storages::postgres::ClusterHostType::kMaster,
+          userver::storages::postgres::Query{
+              "select coalesce(bool_or(expires_at is null) or max(expires_at) > localtimestamp, false) "
+              "from " + name});
+      if (live.AsSingleRow<bool>())
+      {
+        continue;
+      }
+
+      // A tombstone without a key makes the linkstore cache reload in full
+      // instead of reading a tombstone per dropped link
+      const userver::storages::postgres::Query kPartitionTombstone{
+          "insert into linkstore_tombstone (delete_time) values (timezone('UTC', now()))",
+          userver::storages::postgres::Query::Name{"insert_partition_tombstone"},
+      };
+      // Detach concurrently is refused while linkstore_default exists: the
+      // plain one holds its exclusive lock on linkstore for this short
+      // transaction only, and gives up instead of queueing behind long readers
+      userver::storages::postgres::Transaction transaction = m_pg_cluster->Begin(
+          "sample_transaction_drop_expired_partition",
+          userver::storages::postgres::ClusterHostType::kMaster, {});
+      transaction.Execute(userver::storages::postgres::Query{"set local lock_timeout = '1s'"});
+      transaction.Execute(userver::storages::postgres::Query{"alter table linkstore detach partition " + name});
+      transaction.Execute(kPartitionTombstone);
+      transaction.Execute(userver::storages::postgres::Query{"drop table " + name});
+      transaction.Commit();
+      ++dropped;
+      LOG_INFO() << "Dropped expired linkstore partition " << name;
+    }
+    catch(const std::exception& e)
+    {
+      // The next partitions and the row cleanup still run, the failed one
+      // is retried on the next tick
+      LOG_WARNING() << "Cannot drop expired linkstore partition " << name << ": " << e.what();
+    }
+  }
+  return dropped;
 }
 
 std::string DBHelper::getSettingValue(const std::string& setting_name) const {
@@ -262,8 +1017,8 @@ void DBHelper::saveRequestResult(
         userver::storages::postgres::ClusterHostType::kMaster, {});
 
     const userver::storages::postgres::Query kInsertValue{
-        "INSERT INTO linkstorelogger (request_perform_time, token, longUrl, request_timeout, request_attempt, request_code, error) "
-        "VALUES (current_timestamp, $1, $2, $3, $4, $5, $6) ",
+        "INSERT INTO linkstorelogger (request_time, token, longUrl, request_timeout, request_attempt, request_code, error) "
+        "VALUES (timezone('UTC', now()), $1, $2, $3, $4, $5, $6) ",
         userver::storages::postgres::Query::Name{"insert_or_log_info"},
     };
     transaction.Execute(kInsertValue, token, longUrlFind, request_timeout_second,
@@ -277,3 +1032,48 @@ void DBHelper::saveRequestResult(
   }
 }
 
+
+void DBHelper::saveRequestResults(const std::vector<RequestLogEvent>& events) const
+{
+  std::vector<userver::storages::postgres::TimePointWithoutTz> requestTimes;
+  std::vector<std::string> tokens;
+  std::vector<std::string> longUrls;
+  std::vector<int> timeouts;
+  std::vector<int> attempts;
+  std::vector<int> codes;
+  std::vector<std::string> errors;
+  requestTimes.reserve(events.size());
+  tokens.reserve(events.size());
+  longUrls.reserve(events.size());
+  timeouts.reserve(events.size());
+  attempts.reserve(events.size());
+  codes.reserve(events.size());
+  errors.reserve(events.size());
+  for (const auto& event : events)
+  {
+    requestTimes.emplace_back(event.requestTime);
+    tokens.push_back(event.token);
+    longUrls.push_back(event.longUrl);
+    timeouts.push_back(event.requestTimeoutSecond);
+    attempts.push_back(event.requestAttempt);
+    codes.push_back(event.requestCode);
+    errors.push_back(event.error);
+  }
+
+  try
+  {
+    const userver::storages::postgres::Query kInsertValues{
+        "INSERT INTO linkstorelogger (request_time, token, longUrl, request_timeout, request_attempt, request_code, error) "
+        "SELECT * FROM unnest($1::timestamp[], $2::text[], $3::text[], $4::integer[], $5::integer[], $6::integer[], $7::text[])",
+        userver::storages::postgres::Query::Name{"insert_log_infos"},
+    };
+    m_pg_cluster->Execute(userver::storages::postgres::ClusterHostType::kMaster,
+                        kInsertValues, requestTimes, tokens, longUrls, timeouts,
+                        attempts, codes, errors);
+  }
+  catch(const std::exception& e)
+  {
+    const std::string errorMess = std::string("Cannot save log info into database.") + e.what();
+    throw DBException(errorMess.c_str());
+  }
+}
@@ -3,50 +3,333 @@
 
 #include <userver/storages/postgres/cluster.hpp>
 #include <userver/storages/postgres/component.hpp>
+#include <userver/storages/postgres/io/chrono.hpp>
 #include <chrono>
 
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <vector>
+
+/**
+ * Primary key of the linkstore table: the token text itself, or the numeric
+ * id the token encodes. With the id key tokens are decoded before lookups.
+ */
+enum class LinkStoreKey
+{
+    token,
+    id
+};
+
+/**
+ * Layout of the linkstore table. Partitioned by the creation hour or day,
+ * expired links are removed by dropping whole partitions instead of
+ * deleting rows. Long urls are then deduplicated within a partition only.
+ */
+enum class LinkStorePartitioning
+{
+    none,
+    hourly,
+    daily
+};
+
+/**
+ * How GET answers for a link: fetches the long url and returns its body,
+ * or redirects to it with the status of the same value. Stored in the
+ * response_mode column, null there stands for the service default.
+ */
+enum class ResponseMode : int16_t
+{
+    proxy = 0,
+    movedPermanently = 301,
+    found = 302,
+    temporaryRedirect = 307
+};
+
+/**
+ * What GET of a token leads to, as kept by the in-memory caches.
+ */
+struct LinkTarget
+{
+    std::string longUrl;
+    std::optional<ResponseMode> responseMode;
+};
+
+/**
+ * Long url of a token together with the time it stays valid, std::nullopt
+ * when the link never expires.
+ */
+struct LongUrlInfo
+{
+    std::string longUrl;
+    std::optional<std::chrono::seconds> timeToLive;
+    std::optional<ResponseMode> responseMode;
+};
+
+/**
+ * Long url of one of the links looked up at once, the key column of the
+ * current LinkStoreKey mode is filled.
+ */
+struct ResolvedLink
+{
+    std::string token;
+    int64_t id = 0;
+    LongUrlInfo info;
+};
+
+/**
+ * Options of a new link. Without a time to live the expired_token_timestamp
+ * setting applies. A sliding link expires the time to live after its last
+ * access instead of its creation. Without a response mode GET answers the
+ * way the service is configured to.
+ */
+struct LinkOptions
+{
+    std::optional<std::chrono::seconds> timeToLive;
+    bool sliding = false;
+    std::optional<ResponseMode> responseMode;
+};
+
+/**
+ * A linkstore row as loaded by the in-memory caches. Only the key column
+ * of the current LinkStoreKey mode is filled, tombstones carry no link.
+ */
+struct LinkStoreRow
+{
+    std::string token;
+    int64_t id = 0;
+    std::string link;
+    std::optional<int16_t> responseMode;
+    // Seconds until expires_at at load time, std::nullopt for links that never expire
+    std::optional<int64_t> secondsLeft;
+};
+
+/**
+ * Key a long url is stored under, only the column of the current
+ * LinkStoreKey mode is filled. inserted is false when the url was already
+ * stored, by an earlier or a concurrent request.
+ */
+struct StoredLink
+{
+    std::string token;
+    int64_t id = 0;
+    bool inserted = false;
+    // Options the link is stored with, those of the live link of the url
+    // when it was not inserted
+    std::optional<int32_t> ttlSeconds;
+    bool sliding = false;
+    std::optional<int16_t> responseMode;
+};
+
+/**
+ * Key of a long url found or stored by the batch requests, identified by
+ * the hex encoded digest of the url.
+ */
+struct DigestLink
+{
+    std::string digest;
+    std::string token;
+    int64_t id = 0;
+    bool inserted = false;
+};
+
+/**
+ * Outcome of a DBHelper::cleanExpiredData() run. finished is false when the
+ * time budget ran out before all expired links were deleted.
+ */
+struct ExpiredCleanup
+{
+    std::uint64_t rowsDeleted = 0;
+    std::uint64_t batches = 0;
+    std::uint64_t partitionsDropped = 0;
+    bool finished = true;
+};
+
+/**
+ * Result of a redirect as stored in linkstorelogger.
+ */
+struct RequestLogEvent
+{
+    std::chrono::system_clock::time_point requestTime;
+    std::string token;
+    std::string longUrl;
+    int requestTimeoutSecond = 0;
+    int requestAttempt = 0;
+    int requestCode = 0;
+    std::string error;
+};
 
 class DBHelper
 {
     userver::storages::postgres::ClusterPtr m_pg_cluster;
+    LinkStoreKey m_keyMode;
+    LinkStorePartitioning m_partitioning;
     static inline const std::string DROP_LISKSTORE = "drop table if exists linkstore;";
-    static inline const std::string CREATE_LISKSTORE = "create table if not exists linkstore(token varchar(200) primary key, link text, create_time timestamp);";
+
+    // Long urls are deduplicated by a fixed-width digest instead of the whole text.
+    // Inserts name the constraint, so they fit both layouts
+    static inline const std::string CREATE_LISKSTORE = "create table if not exists linkstore(token varchar(200) primary key, link text, link_digest bytea not null, create_time timestamp, expires_at timestamp, "
+        "ttl_seconds integer, sliding boolean not null default false, response_mode smallint, "
+        "constraint linkstore_link_digest_key unique (link_digest));";
+    static inline const std::string CREATE_LISKSTORE_BY_ID = "create table if not exists linkstore(id bigint primary key, link text, link_digest bytea not null, create_time timestamp, expires_at timestamp, "
+        "ttl_seconds integer, sliding boolean not null default false, response_mode smallint, "
+        "constraint linkstore_link_digest_key unique (link_digest));";
+    static constexpr std::size_t LINK_DIGEST_SIZE = 16;
+
+    // Unique keys of a partitioned table must contain the partition key: the
+    // period column truncates create_time to the partition boundaries
+    static inline const std::string CREATE_LISKSTORE_PARTITIONED = "create table if not exists linkstore({key} not null, link text, link_digest bytea not null, create_time timestamp, expires_at timestamp, "
+        "ttl_seconds integer, sliding boolean not null default false, response_mode smallint, "
+        "create_period timestamp not null default date_trunc('{unit}', localtimestamp), "
+        "primary key ({key_name}, create_period), "
+        "constraint linkstore_link_digest_key unique (link_digest, create_period)) partition by range (create_period);";
+    static inline const std::string CREATE_LISKSTORE_DEFAULT = "create table if not exists linkstore_default partition of linkstore default;";
+    static inline const std::string LINK_PARTITIONS_AHEAD = "1 day";
+    static inline const std::string CREATE_LISKSTORE_CREATE_TIME_INDEX = "create index if not exists linkstore_create_time_idx on linkstore(create_time);";
+    static inline const std::string CREATE_LISKSTORE_EXPIRES_AT_INDEX = "create index if not exists linkstore_expires_at_idx on linkstore(expires_at);";
+
+    // Deleted and expired links, so incremental cache updates can drop them
+    static inline const std::string DROP_LISKSTORE_TOMBSTONE = "drop table if exists linkstore_tombstone;";
+    static inline const std::string CREATE_LISKSTORE_TOMBSTONE = "create table if not exists linkstore_tombstone(token varchar(200), id bigint, delete_time timestamp);";
+    static inline const std::string CREATE_LISKSTORE_TOMBSTONE_INDEX = "create index if not exists linkstore_tombstone_delete_time_idx on linkstore_tombstone(delete_time);";
+    static inline const std::chrono::hours TOMBSTONE_RETENTION{24};
 
     static inline const std::string DROP_LISKSTORELOGGER = "drop table if exists linkstorelogger;";
+    // Append-only: no primary key to maintain, daily range partitions and a
+    // BRIN index, which stays tiny while rows arrive in time order
     static inline const std::string CREATE_LISKSTORELOGGER =
         "create table if not exists linkstorelogger"
-        "(request_time timestamp primary key, "
+        "(request_time timestamp not null, "
         "token varchar(200),"
         "longUrl text, "
         "request_timeout integer, "
         "request_attempt integer, "
         "request_code integer,"
-        "error text);";
+        "error text) partition by range (request_time);";
+    static inline const std::string CREATE_LISKSTORELOGGER_DEFAULT =
+        "create table if not exists linkstorelogger_default partition of linkstorelogger default;";
+    static inline const std::string CREATE_LISKSTORELOGGER_INDEX =
+        "create index if not exists linkstorelogger_request_time_idx on linkstorelogger using brin(request_time);";
+    static constexpr int LOG_PARTITIONS_AHEAD_DAYS = 2;
+
+    static inline const std::string CREATE_ID_LEASE =
+        "create table if not exists id_lease"
+        "(name varchar(64) primary key, "
+        "next_id bigint not null);";
+    static inline const std::string INIT_ID_LEASE =
+        "insert into id_lease (name, next_id) values ('linkstore', 1) "
+        "on conflict do nothing;";
 
     static inline const std::string DROP_SETTINGS = "drop table if exists service_settings;";
     static inline const std::string CREATE_SETTINGS = "create table if not exists service_settings(name varchar(250) primary key, value varchar(200));";
 
 
 public:
-    DBHelper(userver::storages::postgres::ClusterPtr pg_cluster): m_pg_cluster(pg_cluster)
+    DBHelper(userver::storages::postgres::ClusterPtr pg_cluster,
+             const LinkStoreKey keyMode = LinkStoreKey::token,
+             const LinkStorePartitioning partitioning = LinkStorePartitioning::none)
+        : m_pg_cluster(pg_cluster), m_keyMode(keyMode), m_partitioning(partitioning)
     {
         
     }
 
+    LinkStoreKey keyMode() const { return m_keyMode; }
+
     void prepareDB(const bool needReCreate = false);
 
     void prepareSettingsTable(const bool needReCreate = false) const;
 
-    void saveTokenInfo(const std::string& token, const std::string& longUrl) const;
+    /**
+     * 128-bit digest of a long url, the truncated SHA-256 stored in the
+     * unique link_digest column.
+     */
+    static std::string linkDigest(const std::string& longUrl);
 
-    std::optional<std::string> findToken(const std::string& longUrl) const;
+    /**
+     * Stores the long url under the given key unless it is already stored,
+     * in a single statement. Concurrent calls for one url agree on the key.
+     */
+    StoredLink shortenUrl(const std::string& token, const std::string& longUrl,
+                          const LinkOptions& options = {}) const;
+    StoredLink shortenUrl(const int64_t id, const std::string& longUrl,
+                          const LinkOptions& options = {}) const;
+
+    /**
+     * Keys of the already stored long urls among the given hex encoded
+     * digests, in a single query. Read from a replica: urls missed because
+     * of the replication lag are still deduplicated by shortenUrls().
+     */
+    std::vector<DigestLink> findLinks(const std::vector<std::string>& digests) const;
+
+    /**
+     * Batch form of shortenUrl() in a single statement. Urls must be
+     * distinct, keys are the tokens or the ids depending on the mode.
+     */
+    std::vector<DigestLink> shortenUrls(
+        const std::vector<std::string>& tokens,
+        const std::vector<int64_t>& ids,
+        const std::vector<std::string>& longUrls,
+        const std::vector<std::string>& digests) const;
 
     std::string getLongUrl(const std::string& token) const;
 
-    void deleteLongUrlInfo(const std::string& token) const;
+    std::optional<LongUrlInfo> getLongUrlInfo(const std::string& token) const;
+    std::optional<LongUrlInfo> getLongUrlInfo(const int64_t id) const;
+
+    /// Long urls of the existing links among the given ones, in a single query
+    std::vector<ResolvedLink> getLongUrlInfos(const std::vector<std::string>& tokens) const;
+    std::vector<ResolvedLink> getLongUrlInfos(const std::vector<int64_t>& ids) const;
+
+    /**
+     * Moves expiry of the sliding links among the given ones a time to live
+     * past now, in a single statement. Returns the number of links extended.
+     */
+    std::size_t touchLinks(const std::vector<std::string>& tokens) const;
+    std::size_t touchLinks(const std::vector<int64_t>& ids) const;
+
+    int64_t leaseIdBlock(const int64_t blockSize) const;
+
+    /**
+     * Links created since the given time, the whole table for std::nullopt.
+     * create_time and delete_time are written in UTC, so the time is one of
+     * std::chrono::system_clock whatever the timezone of the database.
+     */
+    std::vector<LinkStoreRow> loadLinks(
+        const std::optional<userver::storages::postgres::TimePointWithoutTz>& since) const;
+
+    /**
+     * Same as loadLinks() without the long urls.
+     */
+    std::vector<LinkStoreRow> loadKeys(
+        const std::optional<userver::storages::postgres::TimePointWithoutTz>& since) const;
 
-    void cleanExpiredData();
+    std::vector<LinkStoreRow> loadTombstones(
+        const userver::storages::postgres::TimePointWithoutTz& since) const;
+
+    /// Returns the digest of the deleted long url, std::nullopt if nothing was deleted
+    std::optional<std::string> deleteLongUrlInfo(const std::string& token) const;
+    std::optional<std::string> deleteLongUrlInfo(const int64_t id) const;
+
+    /**
+     * Removes the links past their expires_at, at most batchSize rows per
+     * statement until none are left or timeBudget runs out. A partitioned
+     * linkstore first drops the ended partitions whose links all expired,
+     * sliding ones included, and leaves a tombstone without a key for them.
+     */
+    ExpiredCleanup cleanExpiredData(const std::size_t batchSize,
+                                    const std::chrono::milliseconds timeBudget);
+
+    /**
+     * Creates the linkstore partitions from the current one up to
+     * LINK_PARTITIONS_AHEAD ahead, does nothing for an unpartitioned linkstore.
+     */
+    void prepareLinkPartitions() const;
+
+    /**
+     * Creates the daily linkstorelogger partitions from today up to
+     * LOG_PARTITIONS_AHEAD_DAYS ahead, rows outside of them go to the default one.
+     */
+    void prepareLogPartitions() const;
 
     std::string getSettingValue(const std::string& setting_name) const;
 
@@ -60,6 +343,15 @@ public:
         const int request_code,
         const std::string& error) const;
 
+    /// Inserts the events in a single statement
+    void saveRequestResults(const std::vector<RequestLogEvent>& events) const;
+
+private:
+    std::uint64_t dropExpiredPartitions() const;
+
+    std::vector<LinkStoreRow> loadRows(
+        const std::string& select, const std::string& name,
+        const std::optional<userver::storages::postgres::TimePointWithoutTz>& since) const;
 };
 
 #endif
\ No newline at end of file
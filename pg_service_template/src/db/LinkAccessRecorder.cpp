@@ -0,0 +1,120 @@
+#include "LinkAccessRecorder.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#include <userver/logging/log.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/DBException.hpp"
+#include "../exceptions/InternalException.hpp"
+
+namespace {
+
+template <typename Key>
+std::vector<Key> takeAll(std::unordered_set<Key>& keys)
+{
+    std::vector<Key> taken(std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.end()));
+    keys.clear();
+    return taken;
+}
+
+}  // namespace
+
+LinkAccessRecorder::LinkAccessRecorder(const Settings& settings, const DBHelper& dbHelper,
+                                       userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings),
+      m_dbHelper(dbHelper)
+{
+    if (m_settings.batchSize == 0 || m_settings.maxPending == 0)
+    {
+        throw InternalLogicException("Sliding expiry batch size and pending limit must be positive");
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        "link-access", [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+
+    m_flushTask.Start("link_access_flush",
+                      userver::utils::PeriodicTask::Settings{m_settings.flushInterval},
+                      [this] { flush(); });
+}
+
+LinkAccessRecorder::~LinkAccessRecorder()
+{
+    m_flushTask.Stop();
+    m_statisticsEntry.Unregister();
+    flush();
+}
+
+void LinkAccessRecorder::record(const std::string& token, int64_t id)
+{
+    const bool byId = m_dbHelper.keyMode() == LinkStoreKey::id;
+    {
+        std::lock_guard<userver::engine::Mutex> lock(m_mutex);
+        const auto pending = byId ? m_ids.size() : m_tokens.size();
+        if (pending >= m_settings.maxPending)
+        {
+            // Keys already pending are still extended by the next flush
+            const bool known = byId ? m_ids.count(id) != 0 : m_tokens.count(token) != 0;
+            if (!known)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        else if (byId)
+        {
+            m_ids.insert(id);
+        }
+        else
+        {
+            m_tokens.insert(token);
+        }
+    }
+    m_recorded.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkAccessRecorder::flush()
+{
+    std::vector<std::string> tokens;
+    std::vector<int64_t> ids;
+    {
+        std::lock_guard<userver::engine::Mutex> lock(m_mutex);
+        tokens = takeAll(m_tokens);
+        ids = takeAll(m_ids);
+    }
+
+    const auto keys = std::max(tokens.size(), ids.size());
+    for (std::size_t begin = 0; begin < keys; begin += m_settings.batchSize)
+    {
+        const auto end = std::min(keys, begin + m_settings.batchSize);
+        try
+        {
+            const auto extended = m_dbHelper.keyMode() == LinkStoreKey::id
+                ? m_dbHelper.touchLinks(std::vector<int64_t>(ids.begin() + begin, ids.begin() + end))
+                : m_dbHelper.touchLinks(std::vector<std::string>(tokens.begin() + begin, tokens.begin() + end));
+            m_extended.fetch_add(extended, std::memory_order_relaxed);
+            m_flushed.fetch_add(end - begin, std::memory_order_relaxed);
+            m_batches.fetch_add(1, std::memory_order_relaxed);
+        }
+        catch (const DBException& e)
+        {
+            LOG_ERROR() << "Lost " << end - begin << " link accesses: " << e.what();
+            m_failed.fetch_add(end - begin, std::memory_order_relaxed);
+        }
+    }
+}
+
+void LinkAccessRecorder::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    writer["recorded"] = userver::utils::statistics::Rate{m_recorded.load()};
+    writer["dropped"] = userver::utils::statistics::Rate{m_dropped.load()};
+    writer["flushed"] = userver::utils::statistics::Rate{m_flushed.load()};
+    writer["extended"] = userver::utils::statistics::Rate{m_extended.load()};
+    writer["batches"] = userver::utils::statistics::Rate{m_batches.load()};
+    writer["failed"] = userver::utils::statistics::Rate{m_failed.load()};
+}
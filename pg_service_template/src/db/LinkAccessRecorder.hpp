@@ -0,0 +1,70 @@
+#ifndef __LINK_ACCESS_RECORDER_HPP__
+#define __LINK_ACCESS_RECORDER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include <userver/engine/mutex.hpp>
+#include <userver/utils/periodic_task.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+#include "DBHelper.hpp"
+
+/**
+ * Keeps sliding links alive. Redirects record the keys of the links they
+ * served in memory, a background task periodically extends the expiry of
+ * the sliding ones among them in batched updates, so a popular link costs
+ * one write per flush instead of one per click.
+ */
+class LinkAccessRecorder
+{
+public:
+    struct Settings
+    {
+        std::chrono::milliseconds flushInterval{1000};
+        // Keys per update statement
+        std::size_t batchSize = 1000;
+        // Distinct keys kept between flushes, further ones are dropped
+        std::size_t maxPending = 100000;
+    };
+
+    LinkAccessRecorder(const Settings& settings, const DBHelper& dbHelper,
+                       userver::utils::statistics::Storage& statisticsStorage);
+
+    /// Flushes the keys recorded since the last flush
+    ~LinkAccessRecorder();
+
+    /// Links are keyed by the token or by its id, depending on the LinkStoreKey mode
+    void record(const std::string& token, int64_t id);
+
+private:
+    LinkAccessRecorder(const LinkAccessRecorder&) = delete;
+    LinkAccessRecorder& operator=(const LinkAccessRecorder&) = delete;
+
+    void flush();
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    const DBHelper m_dbHelper;
+
+    userver::engine::Mutex m_mutex;
+    std::unordered_set<std::string> m_tokens;
+    std::unordered_set<int64_t> m_ids;
+
+    std::atomic<std::uint64_t> m_recorded{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::atomic<std::uint64_t> m_flushed{0};
+    std::atomic<std::uint64_t> m_extended{0};
+    std::atomic<std::uint64_t> m_batches{0};
+    std::atomic<std::uint64_t> m_failed{0};
+
+    userver::utils::PeriodicTask m_flushTask;
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "RequestLogger.hpp"
+
+#include <userver/engine/deadline.hpp>
+#include <userver/logging/log.hpp>
+#include <userver/utils/async.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/DBException.hpp"
+#include "../exceptions/InternalException.hpp"
+
+RequestLogger::RequestLogger(const Settings& settings, const DBHelper& dbHelper,
+                             userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings),
+      m_dbHelper(dbHelper),
+      m_queue(Queue::Create(settings.queueSize)),
+      m_producer(m_queue->GetMultiProducer()),
+      m_consumer(m_queue->GetConsumer())
+{
+    if (m_settings.queueSize == 0 || m_settings.batchSize == 0)
+    {
+        throw InternalLogicException("Request log queue and batch sizes must be positive");
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        "request-log", [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+
+    m_writer = userver::utils::CriticalAsync("request_log_writer", [this] { run(); });
+}
+
+RequestLogger::~RequestLogger()
+{
+    m_statisticsEntry.Unregister();
+
+    // Without producers the writer drains the queue and stops
+    m_producer.reset();
+    m_writer.Wait();
+}
+
+void RequestLogger::write(RequestLogEvent&& event)
+{
+    const bool pushed = m_settings.overflowPolicy == OverflowPolicy::block
+        ? m_producer->Push(std::move(event),
+                           userver::engine::Deadline::FromDuration(m_settings.blockTimeout))
+        : m_producer->PushNoblock(std::move(event));
+
+    if (pushed)
+    {
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RequestLogger::run()
+{
+    std::vector<RequestLogEvent> batch;
+    batch.reserve(m_settings.batchSize);
+
+    RequestLogEvent event;
+    auto deadline = userver::engine::Deadline::FromDuration(m_settings.flushInterval);
+    while (true)
+    {
+        if (m_consumer.Pop(event, deadline))
+        {
+            batch.push_back(std::move(event));
+            if (batch.size() < m_settings.batchSize)
+            {
+                continue;
+            }
+        }
+        else if (!deadline.IsReached())
+        {
+            // All producers are gone and the queue is empty
+            flush(batch);
+            return;
+        }
+
+        flush(batch);
+        deadline = userver::engine::Deadline::FromDuration(m_settings.flushInterval);
+    }
+}
+
+void RequestLogger::flush(std::vector<RequestLogEvent>& batch)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        m_dbHelper.saveRequestResults(batch);
+        m_written.fetch_add(batch.size(), std::memory_order_relaxed);
+        m_batches.fetch_add(1, std::memory_order_relaxed);
+    }
+    catch (const DBException& e)
+    {
+        LOG_ERROR() << "Lost " << batch.size() << " request log events: " << e.what();
+        m_failed.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+    batch.clear();
+}
+
+void RequestLogger::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    writer["depth"] = static_cast<std::uint64_t>(m_queue->GetSizeApproximate());
+    writer["capacity"] = static_cast<std::uint64_t>(m_settings.queueSize);
+    writer["pushed"] = userver::utils::statistics::Rate{m_pushed.load()};
+    writer["dropped"] = userver::utils::statistics::Rate{m_dropped.load()};
+    writer["written"] = userver::utils::statistics::Rate{m_written.load()};
+    writer["failed"] = userver::utils::statistics::Rate{m_failed.load()};
+    writer["batches"] = userver::utils::statistics::Rate{m_batches.load()};
+}
@@ -0,0 +1,80 @@
+#ifndef __REQUEST_LOGGER_HPP__
+#define __REQUEST_LOGGER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <userver/concurrent/mpsc_queue.hpp>
+#include <userver/engine/task/task_with_result.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+#include "DBHelper.hpp"
+
+/**
+ * Writes request results into linkstorelogger off the request path. Handlers
+ * push events into a bounded in-memory queue, a single background task
+ * drains it and inserts the events in batches, once the batch is full or
+ * the flush interval has passed.
+ */
+class RequestLogger
+{
+public:
+    /// What write() does when the queue is full
+    enum class OverflowPolicy
+    {
+        drop,
+        block
+    };
+
+    struct Settings
+    {
+        std::size_t queueSize = 10000;
+        std::size_t batchSize = 500;
+        std::chrono::milliseconds flushInterval{200};
+        OverflowPolicy overflowPolicy = OverflowPolicy::drop;
+        // Longest wait of a blocked write(), the event is dropped after it
+        std::chrono::milliseconds blockTimeout{100};
+    };
+
+    RequestLogger(const Settings& settings, const DBHelper& dbHelper,
+                  userver::utils::statistics::Storage& statisticsStorage);
+
+    /// Flushes the events left in the queue
+    ~RequestLogger();
+
+    void write(RequestLogEvent&& event);
+
+private:
+    using Queue = userver::concurrent::MpscQueue<RequestLogEvent>;
+
+    RequestLogger(const RequestLogger&) = delete;
+    RequestLogger& operator=(const RequestLogger&) = delete;
+
+    void run();
+    void flush(std::vector<RequestLogEvent>& batch);
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    const DBHelper m_dbHelper;
+
+    std::shared_ptr<Queue> m_queue;
+    std::optional<Queue::MultiProducer> m_producer;
+    Queue::Consumer m_consumer;
+
+    std::atomic<std::uint64_t> m_pushed{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_failed{0};
+    std::atomic<std::uint64_t> m_batches{0};
+
+    userver::engine::TaskWithResult<void> m_writer;
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
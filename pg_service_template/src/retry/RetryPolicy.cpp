@@ -0,0 +1,135 @@
+#include "RetryPolicy.hpp"
+
+#include <algorithm>
+
+#include <userver/clients/http/error.hpp>
+#include <userver/engine/sleep.hpp>
+#include <userver/server/request/task_inherited_data.hpp>
+#include <userver/utils/rand.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/InternalException.hpp"
+
+RetryPolicy::RetryPolicy(const Settings& settings, userver::clients::http::Client& httpClient,
+                         userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings),
+      m_httpClient(httpClient)
+{
+    if (m_settings.attempts == 0 || m_settings.baseDelay > m_settings.maxDelay)
+    {
+        throw InternalLogicException("Retry needs an attempt and a base delay not above the max one");
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        "upstream-retry", [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+}
+
+RetryPolicy::~RetryPolicy()
+{
+    m_statisticsEntry.Unregister();
+}
+
+bool RetryPolicy::isRetryableStatus(int status)
+{
+    switch (status)
+    {
+        case 408:
+        case 425:
+        case 429:
+        case 500:
+        case 502:
+        case 503:
+        case 504:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RetryPolicy::Result RetryPolicy::fetch(const std::string& url, const userver::http::headers::HeaderMap& headers,
+                                       std::size_t attemptsMade) const
+{
+    const auto deadline = makeDeadline();
+    Result result;
+    result.attempts = attemptsMade;
+
+    for (std::size_t attempt = attemptsMade; attempt < m_settings.attempts; ++attempt)
+    {
+        if (attempt > 0)
+        {
+            const auto delay = backoff(attempt);
+            if (deadline.TimeLeft() <= delay)
+            {
+                m_deadlineExceeded.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            userver::engine::SleepFor(delay);
+            m_retries.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const auto timeout = std::min(m_settings.attemptTimeout,
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline.TimeLeft()));
+        if (timeout <= std::chrono::milliseconds::zero())
+        {
+            m_deadlineExceeded.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+
+        ++result.attempts;
+        m_attempts.fetch_add(1, std::memory_order_relaxed);
+        try
+        {
+            result.response = m_httpClient.CreateRequest()
+                .get(url)
+                .timeout(timeout)
+                .headers(headers)
+                .perform();
+            result.error.clear();
+            if (!isRetryableStatus(static_cast<int>(result.response->status_code())))
+            {
+                return result;
+            }
+        }
+        catch (const userver::clients::http::TimeoutException& e)
+        {
+            result.error = e.what();
+        }
+        catch (const userver::clients::http::NetworkProblemException& e)
+        {
+            result.error = e.what();
+        }
+    }
+
+    m_exhausted.fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+userver::engine::Deadline RetryPolicy::makeDeadline() const
+{
+    auto deadline = userver::engine::Deadline::FromDuration(m_settings.deadline);
+    const auto inherited = userver::server::request::GetTaskInheritedDeadline();
+    if (inherited.IsReachable() && inherited.TimeLeft() < deadline.TimeLeft())
+    {
+        deadline = inherited;
+    }
+    return deadline;
+}
+
+std::chrono::milliseconds RetryPolicy::backoff(std::size_t attempt) const
+{
+    // Full jitter: uniform up to the exponential delay of the attempt
+    const auto shift = std::min<std::size_t>(attempt - 1, 20);
+    const auto cap = std::min(m_settings.maxDelay, m_settings.baseDelay * (int64_t{1} << shift));
+    return std::chrono::milliseconds{userver::utils::RandRange<int64_t>(0, cap.count() + 1)};
+}
+
+void RetryPolicy::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    writer["attempts"] = userver::utils::statistics::Rate{m_attempts.load()};
+    writer["retries"] = userver::utils::statistics::Rate{m_retries.load()};
+    // Calls still failing when the attempts or the deadline ran out
+    writer["exhausted"] = userver::utils::statistics::Rate{m_exhausted.load()};
+    writer["deadline-exceeded"] = userver::utils::statistics::Rate{m_deadlineExceeded.load()};
+}
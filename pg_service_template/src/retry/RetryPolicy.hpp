@@ -0,0 +1,82 @@
+#ifndef __RETRY_POLICY_HPP__
+#define __RETRY_POLICY_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <userver/clients/http/client.hpp>
+#include <userver/clients/http/response.hpp>
+#include <userver/engine/deadline.hpp>
+#include <userver/http/header_map.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+/**
+ * Repeats GETs of a long url in process. Only timeouts, network errors and
+ * statuses an upstream may answer differently next time (408, 425, 429,
+ * 500, 502, 503, 504) are retried, after an exponential backoff with full
+ * jitter. All attempts of a call share one deadline: the one of the incoming
+ * request when it is sooner than the configured one.
+ */
+class RetryPolicy
+{
+public:
+    struct Settings
+    {
+        // Attempts in total, the first one included
+        std::size_t attempts = 3;
+        std::chrono::milliseconds baseDelay{50};
+        std::chrono::milliseconds maxDelay{1000};
+        std::chrono::milliseconds attemptTimeout{1000};
+        std::chrono::milliseconds deadline{5000};
+    };
+
+    struct Result
+    {
+        // nullptr when no attempt got an answer
+        std::shared_ptr<userver::clients::http::Response> response;
+        std::size_t attempts = 0;
+        // Error of the last attempt without an answer
+        std::string error;
+    };
+
+    RetryPolicy(const Settings& settings, userver::clients::http::Client& httpClient,
+                userver::utils::statistics::Storage& statisticsStorage);
+    ~RetryPolicy();
+
+    static bool isRetryableStatus(int status);
+
+    const Settings& settings() const { return m_settings; }
+
+    /**
+     * GETs the url until it answers with a status not worth retrying or the
+     * attempts or the deadline run out. attemptsMade failed attempts of the
+     * caller count against the limit and the backoff.
+     */
+    Result fetch(const std::string& url, const userver::http::headers::HeaderMap& headers,
+                 std::size_t attemptsMade = 0) const;
+
+private:
+    RetryPolicy(const RetryPolicy&) = delete;
+    RetryPolicy& operator=(const RetryPolicy&) = delete;
+
+    userver::engine::Deadline makeDeadline() const;
+    std::chrono::milliseconds backoff(std::size_t attempt) const;
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    userver::clients::http::Client& m_httpClient;
+
+    mutable std::atomic<std::uint64_t> m_attempts{0};
+    mutable std::atomic<std::uint64_t> m_retries{0};
+    mutable std::atomic<std::uint64_t> m_exhausted{0};
+    mutable std::atomic<std::uint64_t> m_deadlineExceeded{0};
+
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
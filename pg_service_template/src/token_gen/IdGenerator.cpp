@@ -1,31 +1,109 @@
 #include "IdGenerator.hpp"
 
-std::atomic<IDGenerator*> IDGenerator::m_instance;
+#include <mutex>
 
-std::mutex IDGenerator::m_mutex;
+#include <userver/logging/log.hpp>
 
-std::atomic<std::size_t> IDGenerator::m_id = 0;
+#include "../exceptions/InternalException.hpp"
 
-IDGenerator *IDGenerator::getGenerator()
+IDGenerator::IDGenerator(int64_t blockSize, BlockLeaser leaser)
+    : m_blockSize(blockSize),
+      m_leaser(std::move(leaser))
 {
-    IDGenerator *idGen = m_instance.load();
-    if (!idGen)
+    if (m_blockSize <= 0)
     {
-        std::lock_guard<std::mutex> myLock(m_mutex);
-        idGen = m_instance.load(std::memory_order_relaxed);
-        if (!idGen)
+        throw InternalLogicException("Id block size must be positive");
+    }
+    for (auto& slot : m_slots)
+    {
+        slot.block.store(NO_BLOCK);
+    }
+}
+
+int64_t IDGenerator::generateId()
+{
+    for (;;)
+    {
+        const auto claimed = m_claimed.fetch_add(1, std::memory_order_relaxed);
+        const auto block = claimed / m_blockSize;
+        const auto offset = static_cast<int64_t>(claimed % m_blockSize);
+
+        // Exactly one caller claims the middle of a block
+        if (offset == m_blockSize / 2)
         {
-            idGen = new IDGenerator();
-            m_instance.store(idGen);
+            prefetchBlock(block + 1);
         }
+
+        int64_t start = 0;
+        if (!findBlockStart(block, start))
+        {
+            leaseBlock(block);
+            if (!findBlockStart(block, start))
+            {
+                // The slot was reused for a newer block while this caller
+                // was waiting; the claimed id is skipped
+                continue;
+            }
+        }
+        return start + offset;
     }
-    volatile int dummy{};
-    return idGen;
 }
-std::size_t IDGenerator::generateId()
+
+bool IDGenerator::findBlockStart(uint64_t block, int64_t& start) const
 {
-    m_id++;
-    return m_id.load(std::memory_order_relaxed);
+    // Sequence lock: the start is valid only if the slot held the same
+    // block before and after reading it
+    const Slot& slot = m_slots[block % SLOTS_COUNT];
+    if (slot.block.load(std::memory_order_acquire) != block)
+    {
+        return false;
+    }
+    start = slot.start.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.block.load(std::memory_order_relaxed) == block;
 }
 
+void IDGenerator::leaseBlock(uint64_t block)
+{
+    std::lock_guard<userver::engine::Mutex> lock(m_leaseMutex);
+
+    int64_t start = 0;
+    if (findBlockStart(block, start))
+    {
+        return;
+    }
+    // Never overwrite a slot that already serves a newer block
+    if (block + SLOTS_COUNT <= m_newestBlock.load())
+    {
+        return;
+    }
+
+    start = m_leaser(m_blockSize);
+
+    Slot& slot = m_slots[block % SLOTS_COUNT];
+    slot.block.store(NO_BLOCK, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.block.store(block, std::memory_order_release);
+
+    if (block > m_newestBlock.load())
+    {
+        m_newestBlock.store(block);
+    }
+    LOG_INFO() << "Leased id block " << block << " starting at " << start;
+}
 
+void IDGenerator::prefetchBlock(uint64_t block)
+{
+    m_prefetchTasks.AsyncDetach("id_block_prefetch", [this, block] {
+        try
+        {
+            leaseBlock(block);
+        }
+        catch (const std::exception& e)
+        {
+            // The block is leased synchronously when it is reached
+            LOG_WARNING() << "Cannot prefetch id block: " << e.what();
+        }
+    });
+}
@@ -1,30 +1,63 @@
 #ifndef _ID_GENERATOR_HPP_
 #define _ID_GENERATOR_HPP_
 
-#include <mutex>
+#include <array>
 #include <atomic>
-#include  <cstring>
+#include <cstdint>
+#include <functional>
+
+#include <userver/concurrent/background_task_storage.hpp>
+#include <userver/engine/mutex.hpp>
+
 /**
- * Singleton. Helps to auto generate unique id for each data 
+ * Hands out unique ids from blocks leased from a persistent counter
+ * (hi/lo allocation). Blocks never overlap between restarts or between
+ * service replicas, so the counter is hit once per block instead of once
+ * per id.
+ *
+ * Every claimed id is a position in the stream of all ids of this process;
+ * block `n` of the stream maps to the n-th leased range. The fast path is a
+ * single fetch_add plus a lookup of the block start in a small ring of
+ * slots. The next block is leased in the background once half of the
+ * current one is used.
  */
 class IDGenerator
 {    
 public:
-    static IDGenerator* getGenerator();
-    std::size_t generateId();
+    /// Leases `blockSize` ids and returns the first one of the range
+    using BlockLeaser = std::function<int64_t(int64_t blockSize)>;
+
+    IDGenerator(int64_t blockSize, BlockLeaser leaser);
+
+    int64_t generateId();
 
 private:
-    IDGenerator()
-    {
-        m_id.store(0);
-    }
-    ~IDGenerator() = default;
     IDGenerator(const IDGenerator& ) = delete;
     IDGenerator& operator=(const IDGenerator&) = delete;
-    static std::atomic<std::size_t> m_id;
 
-    static std::atomic<IDGenerator*> m_instance;
-    static std::mutex m_mutex;
+    struct Slot
+    {
+        // Index of the block whose start is stored in the slot
+        std::atomic<uint64_t> block;
+        std::atomic<int64_t> start{0};
+    };
+
+    static constexpr std::size_t SLOTS_COUNT = 4;
+    static constexpr uint64_t NO_BLOCK = UINT64_MAX;
+
+    bool findBlockStart(uint64_t block, int64_t& start) const;
+    void leaseBlock(uint64_t block);
+    void prefetchBlock(uint64_t block);
+
+    const int64_t m_blockSize;
+    const BlockLeaser m_leaser;
+
+    std::atomic<uint64_t> m_claimed{0};
+    std::atomic<uint64_t> m_newestBlock{0};
+    std::array<Slot, SLOTS_COUNT> m_slots;
+
+    userver::engine::Mutex m_leaseMutex;
+    userver::concurrent::BackgroundTaskStorage m_prefetchTasks;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,17 +1,76 @@
 #include "TokenGenerator.hpp"
+#include <array>
 #include <string>
 
-#include <sqids/sqids.hpp>
-#include "IdGenerator.hpp"
-#include  <cstring>
+#include <userver/logging/log.hpp>
 
-std::string TokenGenerator::generateToken()
+TokenGenerator::TokenGenerator(IDGenerator& idGenerator, const sqidscxx::SqidsOptions& options)
+    : m_idGenerator(idGenerator),
+      m_sqids(options)
 {
-    sqidscxx::Sqids<int64_t> sqids({ minLength: 15 });
-    const auto id = IDGenerator::getGenerator()->generateId();
-    std::vector<int64_t> encodedToInt({id});
-    const auto idEncoded = sqids.encode(encodedToInt);
-    
-    std::cout << "Generated id " << idEncoded << std::endl;
+}
+
+void TokenGenerator::enablePool(const TokenPool::Settings& settings,
+                                userver::utils::statistics::Storage& statisticsStorage)
+{
+    m_pool = std::make_unique<TokenPool>(settings, [this] { return encodeToken(); },
+                                         statisticsStorage);
+}
+
+std::string TokenGenerator::generateToken() const
+{
+    if (m_pool)
+    {
+        auto token = m_pool->pop();
+        if (token.has_value())
+        {
+            return std::move(*token);
+        }
+    }
+    return encodeToken();
+}
+
+std::string TokenGenerator::encodeToken() const
+{
+    const auto idEncoded = encodeId(m_idGenerator.generateId());
+
+    LOG_DEBUG() << "Generated id " << idEncoded;
     return idEncoded;
 }
+
+std::string TokenGenerator::encodeId(int64_t id) const
+{
+    std::array<char, sqidscxx::Sqids<int64_t>::maxSingleIdLength> buffer;
+    const auto length = m_sqids.encodeInto(id, buffer.data(), buffer.size());
+    return std::string(buffer.data(), length);
+}
+
+bool TokenGenerator::isWellFormed(std::string_view token) const
+{
+    return m_sqids.isWellFormed(token);
+}
+
+std::optional<int64_t> TokenGenerator::decodeId(std::string_view token) const
+{
+    int64_t id = 0;
+    if (m_sqids.decodeInto(token, &id, 1) != 1)
+    {
+        return std::nullopt;
+    }
+
+    // Only the canonical encoding of the id is accepted
+    try
+    {
+        std::array<char, sqidscxx::Sqids<int64_t>::maxSingleIdLength> buffer;
+        const auto length = m_sqids.encodeInto(id, buffer.data(), buffer.size());
+        if (std::string_view(buffer.data(), length) != token)
+        {
+            return std::nullopt;
+        }
+    }
+    catch (const std::runtime_error&)
+    {
+        return std::nullopt;
+    }
+    return id;
+}
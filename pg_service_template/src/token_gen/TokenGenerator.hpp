@@ -1,12 +1,56 @@
 #ifndef __TOKEN_GENERATOR_HPP__
 #define __TOKEN_GENERATOR_HPP__
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
+#include <sqids/sqids.hpp>
+
+#include "IdGenerator.hpp"
+#include "TokenPool.hpp"
+
+/**
+ * Generates short link tokens. Holds a single prebuilt Sqids encoder, so the
+ * alphabet validation, shuffle and blocklist preparation are paid once at
+ * startup. The encoder is immutable after construction and safe to share
+ * between handler tasks.
+ */
 class TokenGenerator
 {
 public:
-   static std::string generateToken();
+   TokenGenerator(IDGenerator& idGenerator, const sqidscxx::SqidsOptions& options);
+
+   /**
+    * Starts a background pool of pre-generated tokens. generateToken() pops
+    * from it and encodes inline only when the pool is empty.
+    */
+   void enablePool(const TokenPool::Settings& settings,
+                   userver::utils::statistics::Storage& statisticsStorage);
+
+   std::string generateToken() const;
+
+   /**
+    * Cheap check that a token could have been produced by this generator:
+    * only alphabet characters, valid structure and an exact re-encoding.
+    * Garbage tokens are rejected without any database access.
+    */
+   bool isWellFormed(std::string_view token) const;
+
+   /// Token of an id, the same one generateToken() gives for it
+   std::string encodeId(int64_t id) const;
+
+   /// Id encoded in a well formed token, std::nullopt for any other token
+   std::optional<int64_t> decodeId(std::string_view token) const;
+
+private:
+   std::string encodeToken() const;
+
+   IDGenerator& m_idGenerator;
+   const sqidscxx::Sqids<int64_t> m_sqids;
+   std::unique_ptr<TokenPool> m_pool;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,201 @@
+#include "TokenGenerator.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include <benchmark/benchmark.h>
+#include <userver/engine/run_standalone.hpp>
+#include <sqids/sqids.hpp>
+#include <sqids/static_sqids.hpp>
+
+namespace {
+
+std::atomic<std::size_t> allocationCount{0};
+
+inline constexpr char kAlphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+using StaticSqids = sqidscxx::StaticSqids<int64_t, kAlphabet, 15>;
+
+sqidscxx::SqidsOptions benchmarkOptions()
+{
+  sqidscxx::SqidsOptions options;
+  options.minLength = 15;
+  return options;
+}
+
+// Leases id blocks from an in-memory counter instead of postgres
+IDGenerator::BlockLeaser localLeaser()
+{
+  return [next = std::make_shared<std::atomic<int64_t>>(1)](int64_t blockSize) {
+    return next->fetch_add(blockSize);
+  };
+}
+
+void reportAllocations(benchmark::State& state, const std::size_t allocationsBefore)
+{
+  state.counters["allocs_per_token"] = benchmark::Counter(
+      static_cast<double>(allocationCount.load() - allocationsBefore),
+      benchmark::Counter::kAvgIterations);
+}
+
+}  // namespace
+
+// Counts heap allocations made by the benchmarked code.
+void* operator new(std::size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size))
+  {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+// GCC reports free() on memory from the replaced operator new as mismatched.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Previous behaviour: the encoder is rebuilt for every generated token.
+void SqidsEncoderPerTokenBenchmark(benchmark::State& state) {
+  const auto options = benchmarkOptions();
+  int64_t id = 0;
+
+  const auto allocationsBefore = allocationCount.load();
+  for (auto _ : state) {
+    sqidscxx::Sqids<int64_t> sqids(options);
+    auto result = sqids.encode({++id});
+    benchmark::DoNotOptimize(result);
+  }
+  reportAllocations(state, allocationsBefore);
+}
+
+BENCHMARK(SqidsEncoderPerTokenBenchmark);
+
+void SqidsEncodeBenchmark(benchmark::State& state) {
+  const sqidscxx::Sqids<int64_t> sqids(benchmarkOptions());
+  int64_t id = 0;
+
+  const auto allocationsBefore = allocationCount.load();
+  for (auto _ : state) {
+    auto result = sqids.encode({++id});
+    benchmark::DoNotOptimize(result);
+  }
+  reportAllocations(state, allocationsBefore);
+}
+
+BENCHMARK(SqidsEncodeBenchmark);
+
+void SqidsEncodeIntoBenchmark(benchmark::State& state) {
+  const sqidscxx::Sqids<int64_t> sqids(benchmarkOptions());
+  std::array<char, sqidscxx::Sqids<int64_t>::maxSingleIdLength> buffer;
+  int64_t id = 0;
+
+  const auto allocationsBefore = allocationCount.load();
+  for (auto _ : state) {
+    auto length = sqids.encodeInto(++id, buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(length);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  reportAllocations(state, allocationsBefore);
+}
+
+BENCHMARK(SqidsEncodeIntoBenchmark);
+
+void TokenGeneratorBenchmark(benchmark::State& state) {
+  userver::engine::RunStandalone([&] {
+    IDGenerator idGenerator(10000, localLeaser());
+    const TokenGenerator generator(idGenerator, benchmarkOptions());
+
+    const auto allocationsBefore = allocationCount.load();
+    for (auto _ : state) {
+      auto result = generator.generateToken();
+      benchmark::DoNotOptimize(result);
+    }
+    reportAllocations(state, allocationsBefore);
+  });
+}
+
+BENCHMARK(TokenGeneratorBenchmark);
+
+void SqidsDecodeIntoBenchmark(benchmark::State& state) {
+  const sqidscxx::Sqids<int64_t> sqids(benchmarkOptions());
+  const auto token = sqids.encode({123456789});
+  int64_t number = 0;
+
+  const auto allocationsBefore = allocationCount.load();
+  for (auto _ : state) {
+    auto count = sqids.decodeInto(token, &number, 1);
+    benchmark::DoNotOptimize(count);
+    benchmark::DoNotOptimize(number);
+  }
+  reportAllocations(state, allocationsBefore);
+}
+
+BENCHMARK(SqidsDecodeIntoBenchmark);
+
+void TokenIsWellFormedBenchmark(benchmark::State& state) {
+  userver::engine::RunStandalone([&] {
+    IDGenerator idGenerator(10000, localLeaser());
+    const TokenGenerator generator(idGenerator, benchmarkOptions());
+    const auto token = generator.generateToken();
+
+    const auto allocationsBefore = allocationCount.load();
+    for (auto _ : state) {
+      auto result = generator.isWellFormed(token);
+      benchmark::DoNotOptimize(result);
+    }
+    reportAllocations(state, allocationsBefore);
+  });
+}
+
+BENCHMARK(TokenIsWellFormedBenchmark);
+
+void StaticSqidsEncodeIntoBenchmark(benchmark::State& state) {
+  const StaticSqids sqids;
+  std::array<char, StaticSqids::maxSingleIdLength> buffer;
+  int64_t id = 0;
+
+  const auto allocationsBefore = allocationCount.load();
+  for (auto _ : state) {
+    auto length = sqids.encodeInto(++id, buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(length);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  reportAllocations(state, allocationsBefore);
+}
+
+BENCHMARK(StaticSqidsEncodeIntoBenchmark);
+
+void StaticSqidsDecodeIntoBenchmark(benchmark::State& state) {
+  const StaticSqids sqids;
+  const auto token = sqids.encode({123456789});
+  int64_t number = 0;
+
+  const auto allocationsBefore = allocationCount.load();
+  for (auto _ : state) {
+    auto count = sqids.decodeInto(token, &number, 1);
+    benchmark::DoNotOptimize(count);
+    benchmark::DoNotOptimize(number);
+  }
+  reportAllocations(state, allocationsBefore);
+}
+
+BENCHMARK(StaticSqidsDecodeIntoBenchmark);
@@ -0,0 +1,101 @@
+#include "TokenPool.hpp"
+
+#include <memory>
+
+#include <userver/logging/log.hpp>
+#include <userver/utils/statistics/rate.hpp>
+
+#include "../exceptions/InternalException.hpp"
+
+TokenPool::TokenPool(const Settings& settings, TokenProducer producer,
+                     userver::utils::statistics::Storage& statisticsStorage)
+    : m_settings(settings),
+      m_producer(std::move(producer)),
+      // One more node for the dummy node of the queue
+      m_tokens(settings.capacity + 1)
+{
+    if (m_settings.capacity == 0 || m_settings.lowWatermark > m_settings.capacity)
+    {
+        throw InternalLogicException("Token pool low watermark must not exceed a positive capacity");
+    }
+    if (m_settings.capacity >= MAX_CAPACITY)
+    {
+        throw InternalLogicException("Token pool capacity is too big for a fixed-size lock-free queue");
+    }
+
+    m_statisticsEntry = statisticsStorage.RegisterWriter(
+        "token-pool", [this](userver::utils::statistics::Writer& writer) {
+            writeStatistics(writer);
+        });
+
+    m_refiller.Start("token_pool_refill",
+                     userver::utils::PeriodicTask::Settings{m_settings.refillPeriod},
+                     [this] { refill(); });
+}
+
+TokenPool::~TokenPool()
+{
+    m_refiller.Stop();
+    m_statisticsEntry.Unregister();
+
+    std::string* token = nullptr;
+    while (m_tokens.pop(token))
+    {
+        delete token;
+    }
+}
+
+std::optional<std::string> TokenPool::pop()
+{
+    std::string* token = nullptr;
+    if (!m_tokens.pop(token))
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        m_refiller.ForceStepAsync();
+        return std::nullopt;
+    }
+
+    const std::unique_ptr<std::string> owned(token);
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+
+    // Exactly one caller sees the depth crossing the watermark
+    if (m_depth.fetch_sub(1, std::memory_order_relaxed) == m_settings.lowWatermark)
+    {
+        m_refiller.ForceStepAsync();
+    }
+    return std::move(*owned);
+}
+
+void TokenPool::refill()
+{
+    if (m_depth.load(std::memory_order_relaxed) >= m_settings.lowWatermark)
+    {
+        return;
+    }
+
+    while (m_depth.load(std::memory_order_relaxed) < m_settings.capacity)
+    {
+        auto token = std::make_unique<std::string>(m_producer());
+
+        // Count the token before publishing it, so that pop() never sees
+        // the depth lagging behind the queue
+        m_depth.fetch_add(1, std::memory_order_relaxed);
+        if (!m_tokens.bounded_push(token.get()))
+        {
+            m_depth.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+        token.release();
+        m_refilled.fetch_add(1, std::memory_order_relaxed);
+    }
+    LOG_DEBUG() << "Token pool refilled up to " << m_depth.load() << " tokens";
+}
+
+void TokenPool::writeStatistics(userver::utils::statistics::Writer& writer) const
+{
+    writer["depth"] = static_cast<std::uint64_t>(m_depth.load());
+    writer["capacity"] = static_cast<std::uint64_t>(m_settings.capacity);
+    writer["refilled"] = userver::utils::statistics::Rate{m_refilled.load()};
+    writer["hits"] = userver::utils::statistics::Rate{m_hits.load()};
+    writer["misses"] = userver::utils::statistics::Rate{m_misses.load()};
+}
@@ -0,0 +1,68 @@
+#ifndef __TOKEN_POOL_HPP__
+#define __TOKEN_POOL_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+#include <boost/lockfree/queue.hpp>
+
+#include <userver/utils/periodic_task.hpp>
+#include <userver/utils/statistics/storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+
+/**
+ * Bounded lock-free pool of ready-to-use tokens. A background periodic task
+ * refills the pool up to its capacity whenever the depth drops below the
+ * low watermark, so PUT requests only pop a token instead of allocating an
+ * id and encoding it inline.
+ */
+class TokenPool
+{
+public:
+    using TokenProducer = std::function<std::string()>;
+
+    struct Settings
+    {
+        std::size_t capacity = 1024;
+        std::size_t lowWatermark = 256;
+        std::chrono::milliseconds refillPeriod{100};
+    };
+
+    TokenPool(const Settings& settings, TokenProducer producer,
+              userver::utils::statistics::Storage& statisticsStorage);
+    ~TokenPool();
+
+    std::optional<std::string> pop();
+
+private:
+    // Fixed-size boost::lockfree queues address nodes with 16-bit indices
+    static constexpr std::size_t MAX_CAPACITY = 65535;
+
+    TokenPool(const TokenPool&) = delete;
+    TokenPool& operator=(const TokenPool&) = delete;
+
+    void refill();
+    void writeStatistics(userver::utils::statistics::Writer& writer) const;
+
+    const Settings m_settings;
+    const TokenProducer m_producer;
+
+    // Tokens are heap allocated by the refill task and owned by the queue
+    // until popped: the lock-free queue only stores trivially copyable values
+    boost::lockfree::queue<std::string*, boost::lockfree::fixed_sized<true>> m_tokens;
+
+    std::atomic<std::size_t> m_depth{0};
+    std::atomic<std::uint64_t> m_refilled{0};
+    std::atomic<std::uint64_t> m_hits{0};
+    std::atomic<std::uint64_t> m_misses{0};
+
+    userver::utils::PeriodicTask m_refiller;
+    userver::utils::statistics::Entry m_statisticsEntry;
+};
+
+#endif
@@ -30,3 +30,34 @@ def pgsql_local(service_source_dir, pgsql_local_create):
         [service_source_dir.joinpath('postgresql/schemas')],
     )
     return pgsql_local_create(list(databases.values()))
+
+
+
+def pytest_terminal_summary(terminalreporter):
+    """Prints the measurements the benchmarks record as properties"""
+    for report in terminalreporter.getreports('passed'):
+        for name, value in report.user_properties:
+            terminalreporter.write_line(f'{report.nodeid}: {name} {value}')
+
+@pytest.fixture
+def short_token():
+    """Token of the short url in an answer of PUT /v1/shorten"""
+
+    def _token(response):
+        return response.text.strip().rsplit('/', 1)[-1]
+
+    return _token
+
+
+@pytest.fixture
+def shorten_proxied(service_client, short_token):
+    """Shortens a url answered by proxying it, returns the token"""
+
+    async def _shorten(url):
+        response = await service_client.put(
+            '/v1/shorten', params={'mode': 'proxy'}, data=url,
+        )
+        assert response.status == 201
+        return short_token(response)
+
+    return _shorten
@@ -0,0 +1,54 @@
+import time
+
+import aiohttp
+
+
+# Start the tests via `make test-debug` or `make test-release`
+
+BODY_SIZE = 32 * 1024 * 1024
+
+
+async def test_proxy_streams_large_body(
+        service_client, service_baseurl, mockserver, short_token,
+):
+    @mockserver.handler('/stream-upstream')
+    def upstream(request):
+        return mockserver.make_response(
+            'x' * BODY_SIZE, 200, content_type='application/octet-stream',
+        )
+
+    created = await service_client.put(
+        '/v1/shorten',
+        params={'mode': 'proxy'},
+        data=mockserver.url('stream-upstream'),
+    )
+    assert created.status == 201
+    token = short_token(created)
+
+    # The service client reads whole bodies, the first byte is timed here
+    async with aiohttp.ClientSession() as session:
+        started = time.monotonic()
+        async with session.get(
+                f'{service_baseurl}v1/shorten/{token}',
+        ) as response:
+            assert response.status == 200
+            assert response.headers['Content-Type'].startswith(
+                'application/octet-stream',
+            )
+            received = len(await response.content.readany())
+            first_byte = time.monotonic() - started
+            async for chunk in response.content.iter_any():
+                received += len(chunk)
+            elapsed = time.monotonic() - started
+
+    assert received == BODY_SIZE
+    assert upstream.times_called == 1
+    print(
+        f'proxy stream: first byte in {first_byte * 1000:.1f}ms, '
+        f'{BODY_SIZE >> 20}MB in {elapsed * 1000:.1f}ms',
+    )
+
+
+async def test_not_found_is_answered_at_once(service_client):
+    response = await service_client.get('/v1/shorten/unknown')
+    assert response.status == 404
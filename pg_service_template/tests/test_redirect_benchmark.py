@@ -0,0 +1,74 @@
+import asyncio
+import time
+
+
+# Start the tests via `make test-debug` or `make test-release`
+
+ROUNDS = 25
+CONCURRENCY = 20
+BODY = 'x' * 16384
+
+
+async def _throughput(service_client, token):
+    started = time.monotonic()
+    responses = []
+    for _ in range(ROUNDS):
+        responses += await asyncio.gather(
+            *[
+                service_client.get(
+                    f'/v1/shorten/{token}', allow_redirects=False,
+                )
+                for _ in range(CONCURRENCY)
+            ],
+        )
+    return responses, len(responses) / (time.monotonic() - started)
+
+
+async def test_redirect_and_proxy_throughput(
+        service_client, mockserver, short_token, record_property,
+):
+    @mockserver.handler('/benchmark-upstream')
+    def upstream(request):
+        return mockserver.make_response(BODY, 200)
+
+    url = mockserver.url('benchmark-upstream')
+    proxied = await service_client.put(
+        '/v1/shorten', params={'mode': 'proxy'}, data=url,
+    )
+    assert proxied.status == 201
+    # An url has a single link, another mode for it is refused with 409
+    redirected = await service_client.put(
+        '/v1/shorten', params={'mode': '302'}, data=url + '?redirect',
+    )
+    assert redirected.status == 201
+
+    proxy_responses, proxy_rps = await _throughput(
+        service_client, short_token(proxied),
+    )
+    assert all(response.status == 200 for response in proxy_responses)
+    assert upstream.times_called == ROUNDS * CONCURRENCY
+
+    redirect_responses, redirect_rps = await _throughput(
+        service_client, short_token(redirected),
+    )
+    assert all(response.status == 302 for response in redirect_responses)
+    assert all(
+        response.headers['Location'] == url + '?redirect'
+        for response in redirect_responses
+    )
+    assert upstream.times_called == ROUNDS * CONCURRENCY
+
+    # Shown in the terminal summary and the junit xml of the run
+    assert proxy_rps > 0 and redirect_rps > 0
+    record_property('proxy-rps', round(proxy_rps))
+    record_property('redirect-rps', round(redirect_rps))
+    record_property('redirect-to-proxy', round(redirect_rps / proxy_rps, 1))
+
+
+async def test_shorten_with_invalid_mode(service_client):
+    response = await service_client.put(
+        '/v1/shorten',
+        params={'mode': '200'},
+        data='http://example.com/invalid-mode',
+    )
+    assert response.status == 400
@@ -0,0 +1,56 @@
+import asyncio
+import time
+
+
+# Start the tests via `make test-debug` or `make test-release`
+
+ROUNDS = 50
+CONCURRENCY = 20
+
+
+async def _wait_written(monitor_client, expected):
+    for _ in range(100):
+        metric = await monitor_client.single_metric('request-log.written')
+        if metric.value >= expected:
+            return metric.value
+        await asyncio.sleep(0.1)
+    return metric.value
+
+
+async def test_request_log_sustains_get_traffic(
+        service_client, monitor_client, mockserver, short_token,
+):
+    @mockserver.handler('/request-log-target')
+    def _target(request):
+        return mockserver.make_response('ok', 200)
+
+    created = await service_client.put(
+        '/v1/shorten', data=mockserver.url('request-log-target'),
+    )
+    assert created.status in (201, 302)
+    token = short_token(created)
+
+    before = await monitor_client.single_metric('request-log.written')
+    dropped_before = await monitor_client.single_metric('request-log.dropped')
+
+    started = time.monotonic()
+    for _ in range(ROUNDS):
+        responses = await asyncio.gather(
+            *[
+                service_client.get(f'/v1/shorten/{token}')
+                for _ in range(CONCURRENCY)
+            ],
+        )
+        assert all(response.status == 200 for response in responses)
+    requests = ROUNDS * CONCURRENCY
+
+    written = await _wait_written(monitor_client, before.value + requests)
+    elapsed = time.monotonic() - started
+    print(
+        f'request log: {written - before.value} rows in {elapsed:.2f}s, '
+        f'{(written - before.value) / elapsed:.0f} rows/s',
+    )
+
+    dropped = await monitor_client.single_metric('request-log.dropped')
+    assert dropped.value == dropped_before.value
+    assert written - before.value == requests
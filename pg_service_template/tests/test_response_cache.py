@@ -0,0 +1,85 @@
+# Start the tests via `make test-debug` or `make test-release`
+
+
+async def test_fresh_answer_is_served_from_cache(
+        service_client, monitor_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/cached-upstream')
+    def upstream(request):
+        return mockserver.make_response(
+            'cached body', 200, headers={'Cache-Control': 'max-age=60'},
+        )
+
+    token = await shorten_proxied(mockserver.url('cached-upstream'))
+    saved_before = await monitor_client.single_metric(
+        'response-cache.bytes-saved',
+    )
+
+    for _ in range(3):
+        response = await service_client.get(f'/v1/shorten/{token}')
+        assert response.status == 200
+        assert response.text == 'cached body'
+    assert upstream.times_called == 1
+
+    saved = await monitor_client.single_metric('response-cache.bytes-saved')
+    assert saved.value - saved_before.value == 2 * len('cached body')
+
+
+async def test_stale_answer_is_revalidated(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/revalidated-upstream')
+    def upstream(request):
+        if request.headers.get('If-None-Match') == '"v1"':
+            return mockserver.make_response('', 304)
+        return mockserver.make_response(
+            'revalidated body',
+            200,
+            headers={'Cache-Control': 'no-cache', 'ETag': '"v1"'},
+        )
+
+    token = await shorten_proxied(mockserver.url('revalidated-upstream'))
+
+    for _ in range(2):
+        response = await service_client.get(f'/v1/shorten/{token}')
+        assert response.status == 200
+        assert response.text == 'revalidated body'
+        assert response.headers['ETag'] == '"v1"'
+    assert upstream.times_called == 2
+
+
+async def test_no_store_answer_is_not_cached(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/uncached-upstream')
+    def upstream(request):
+        return mockserver.make_response(
+            'uncached body', 200, headers={'Cache-Control': 'no-store'},
+        )
+
+    token = await shorten_proxied(mockserver.url('uncached-upstream'))
+
+    for _ in range(2):
+        response = await service_client.get(f'/v1/shorten/{token}')
+        assert response.status == 200
+    assert upstream.times_called == 2
+
+
+async def test_authorized_answer_is_not_cached(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/authorized-upstream')
+    def upstream(request):
+        return mockserver.make_response(
+            'authorized body', 200, headers={'Cache-Control': 'max-age=60'},
+        )
+
+    token = await shorten_proxied(mockserver.url('authorized-upstream'))
+
+    for _ in range(2):
+        response = await service_client.get(
+            f'/v1/shorten/{token}', headers={'Authorization': 'Bearer a'},
+        )
+        assert response.status == 200
+        assert response.text == 'authorized body'
+    assert upstream.times_called == 2
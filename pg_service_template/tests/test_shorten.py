@@ -0,0 +1,148 @@
+import asyncio
+
+
+# Start the tests via `make test-debug` or `make test-release`
+
+
+async def test_shorten_same_url_twice(service_client, short_token):
+    url = 'http://example.com/shorten-twice'
+
+    first = await service_client.put('/v1/shorten', data=url)
+    assert first.status == 201
+
+    second = await service_client.put('/v1/shorten', data=url)
+    assert second.status == 302
+    assert short_token(second) == short_token(first)
+
+
+async def test_concurrent_shorten_has_no_duplicates(
+        service_client, short_token,
+):
+    url = 'http://example.com/concurrent-shorten'
+
+    responses = await asyncio.gather(
+        *[service_client.put('/v1/shorten', data=url) for _ in range(32)],
+    )
+
+    statuses = [response.status for response in responses]
+    assert statuses.count(201) == 1
+    assert statuses.count(302) == len(responses) - 1
+    assert len({short_token(response) for response in responses}) == 1
+
+
+async def test_shorten_batch(service_client, short_token):
+    single = await service_client.put(
+        '/v1/shorten', data='http://example.com/batch-existing',
+    )
+    assert single.status == 201
+
+    urls = [
+        'http://example.com/batch-1',
+        'http://example.com/batch-existing',
+        'http://example.com/batch-2',
+        'http://example.com/batch-1',
+    ]
+    response = await service_client.put(
+        '/v1/shorten/batch',
+        json=urls,
+    )
+    assert response.status == 200
+
+    links = response.json()
+    assert [link['url'] for link in links] == urls
+    assert [link['created'] for link in links] == [True, False, True, False]
+    assert links[1]['token'] == short_token(single)
+    assert links[3]['token'] == links[0]['token']
+    assert len({link['token'] for link in links}) == 3
+
+
+async def test_shorten_batch_lines(service_client):
+    response = await service_client.put(
+        '/v1/shorten/batch',
+        data='http://example.com/lines-1\nhttp://example.com/lines-2\n',
+    )
+    assert response.status == 200
+    assert [link['url'] for link in response.json()] == [
+        'http://example.com/lines-1',
+        'http://example.com/lines-2',
+    ]
+
+
+async def test_resolve(service_client, short_token):
+    url = 'http://example.com/resolve'
+    created = await service_client.put('/v1/shorten', data=url)
+    assert created.status == 201
+    token = short_token(created)
+
+    response = await service_client.post(
+        '/v1/resolve',
+        json=[token, 'unknown-token', token],
+    )
+    assert response.status == 200
+    assert response.json() == {token: url, 'unknown-token': None}
+
+
+async def test_shorten_with_ttl(service_client, short_token):
+    response = await service_client.put(
+        '/v1/shorten',
+        params={'ttl': '3600', 'sliding': 'true'},
+        data='http://example.com/shorten-with-ttl',
+    )
+    assert response.status == 201
+
+    resolved = await service_client.post(
+        '/v1/resolve', json=[short_token(response)],
+    )
+    assert resolved.status == 200
+    assert resolved.json() == {
+        short_token(response): 'http://example.com/shorten-with-ttl',
+    }
+
+
+async def test_shorten_with_invalid_ttl(service_client):
+    for params in ({'ttl': '0'}, {'ttl': 'soon'}, {'sliding': 'maybe'}):
+        response = await service_client.put(
+            '/v1/shorten',
+            params=params,
+            data='http://example.com/shorten-invalid-ttl',
+        )
+        assert response.status == 400
+
+
+async def test_shorten_with_invalid_url(service_client):
+    for url in (
+            'javascript:alert(1)',
+            'ftp://example.com/file',
+            '//example.com/relative',
+            'http://example.com/split\r\nSet-Cookie: a=b',
+    ):
+        response = await service_client.put('/v1/shorten', data=url)
+        assert response.status == 400
+
+    response = await service_client.put(
+        '/v1/shorten/batch',
+        json=['http://example.com/batch-valid', 'javascript:alert(1)'],
+    )
+    assert response.status == 400
+
+
+async def test_shorten_with_conflicting_options(service_client, short_token):
+    url = 'http://example.com/shorten-conflicting-options'
+    created = await service_client.put(
+        '/v1/shorten', params={'ttl': '60', 'mode': '302'}, data=url,
+    )
+    assert created.status == 201
+
+    for params in ({'ttl': '120'}, {'mode': '301'}, {'mode': 'proxy'}):
+        response = await service_client.put(
+            '/v1/shorten', params=params, data=url,
+        )
+        assert response.status == 409
+        assert short_token(response) == short_token(created)
+
+    for params in ({}, {'ttl': '60'}, {'ttl': '60', 'mode': '302'}):
+        response = await service_client.put(
+            '/v1/shorten', params=params, data=url,
+        )
+        assert response.status == 302
+        assert short_token(response) == short_token(created)
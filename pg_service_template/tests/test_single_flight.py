@@ -0,0 +1,81 @@
+import asyncio
+
+
+# Start the tests via `make test-debug` or `make test-release`
+
+CONCURRENCY = 50
+
+
+async def test_concurrent_gets_share_the_lookup(
+        service_client, monitor_client, short_token,
+):
+    url = 'http://example.com/single-flight'
+    created = await service_client.put(
+        '/v1/shorten', params={'mode': '302'}, data=url,
+    )
+    assert created.status == 201
+    token = short_token(created)
+
+    leaders_before = await monitor_client.single_metric(
+        'link-lookup-flight.leaders',
+    )
+    collapsed_before = await monitor_client.single_metric(
+        'link-lookup-flight.collapsed',
+    )
+
+    responses = await asyncio.gather(
+        *[
+            service_client.get(
+                f'/v1/shorten/{token}', allow_redirects=False,
+            )
+            for _ in range(CONCURRENCY)
+        ],
+    )
+    assert all(response.status == 302 for response in responses)
+    assert all(response.headers['Location'] == url for response in responses)
+
+    leaders = await monitor_client.single_metric('link-lookup-flight.leaders')
+    collapsed = await monitor_client.single_metric(
+        'link-lookup-flight.collapsed',
+    )
+    # The rest of the GETs are answered by the link cache
+    lookups = leaders.value - leaders_before.value
+    waited = collapsed.value - collapsed_before.value
+    assert lookups >= 1
+    assert lookups + waited <= CONCURRENCY
+    print(
+        f'single flight: {lookups} lookups, {waited} collapsed '
+        f'of {CONCURRENCY} GETs',
+    )
+
+
+async def test_concurrent_gets_share_the_upstream_fetch(
+        service_client, monitor_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/slow-viral-upstream')
+    async def upstream(request):
+        # Keeps the first fetch in flight while the other GETs arrive
+        await asyncio.sleep(0.5)
+        return mockserver.make_response(
+            'viral body', 200, headers={'Cache-Control': 'max-age=60'},
+        )
+
+    token = await shorten_proxied(mockserver.url('slow-viral-upstream'))
+    collapsed_before = await monitor_client.single_metric(
+        'upstream-flight.collapsed',
+    )
+
+    responses = await asyncio.gather(
+        *[
+            service_client.get(f'/v1/shorten/{token}')
+            for _ in range(CONCURRENCY)
+        ],
+    )
+    assert all(response.status == 200 for response in responses)
+    assert all(response.text == 'viral body' for response in responses)
+    assert upstream.times_called == 1
+
+    collapsed = await monitor_client.single_metric(
+        'upstream-flight.collapsed',
+    )
+    assert collapsed.value > collapsed_before.value
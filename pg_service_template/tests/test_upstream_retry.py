@@ -0,0 +1,81 @@
+# Start the tests via `make test-debug` or `make test-release`
+
+
+async def test_unavailable_upstream_is_retried(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/flaky-upstream')
+    def upstream(request):
+        if upstream.times_called == 0:
+            return mockserver.make_response('busy', 503)
+        return mockserver.make_response('recovered', 200)
+
+    token = await shorten_proxied(mockserver.url('flaky-upstream'))
+
+    response = await service_client.get(f'/v1/shorten/{token}')
+    assert response.status == 200
+    assert response.text == 'recovered'
+    assert upstream.times_called == 2
+
+
+async def test_not_found_upstream_is_not_retried(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/missing-upstream')
+    def upstream(request):
+        return mockserver.make_response('missing', 404)
+
+    token = await shorten_proxied(mockserver.url('missing-upstream'))
+
+    response = await service_client.get(f'/v1/shorten/{token}')
+    assert response.status == 404
+    assert upstream.times_called == 1
+
+
+async def test_retries_stop_after_the_attempts(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/down-upstream')
+    def upstream(request):
+        return mockserver.make_response('down', 502)
+
+    token = await shorten_proxied(mockserver.url('down-upstream'))
+
+    response = await service_client.get(f'/v1/shorten/{token}')
+    assert response.status == 502
+    # attempts of upstream-retry in the static config
+    assert upstream.times_called == 3
+
+
+async def test_timed_out_upstream_is_retried(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/slow-upstream')
+    def upstream(request):
+        if upstream.times_called == 0:
+            raise mockserver.TimeoutError()
+        return mockserver.make_response('in time', 200)
+
+    token = await shorten_proxied(mockserver.url('slow-upstream'))
+
+    response = await service_client.get(f'/v1/shorten/{token}')
+    assert response.status == 200
+    assert response.text == 'in time'
+    assert upstream.times_called == 2
+
+
+async def test_dropped_connection_is_retried(
+        service_client, mockserver, shorten_proxied,
+):
+    @mockserver.handler('/dropping-upstream')
+    def upstream(request):
+        if upstream.times_called == 0:
+            raise mockserver.NetworkError()
+        return mockserver.make_response('reconnected', 200)
+
+    token = await shorten_proxied(mockserver.url('dropping-upstream'))
+
+    response = await service_client.get(f'/v1/shorten/{token}')
+    assert response.status == 200
+    assert response.text == 'reconnected'
+    assert upstream.times_called == 2
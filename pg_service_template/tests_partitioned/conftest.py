@@ -0,0 +1,37 @@
+import pathlib
+
+import pytest
+
+from testsuite.databases.pgsql import discover
+
+
+pytest_plugins = ['pytest_userver.plugins.postgresql']
+
+USERVER_CONFIG_HOOKS = ['userver_config_partitioned_linkstore']
+
+
+@pytest.fixture(scope='session')
+def userver_config_partitioned_linkstore():
+    """Runs the service on the daily partitioned linkstore"""
+
+    def patch_config(config_yaml, config_vars):
+        components = config_yaml['components_manager']['components']
+        components['handler-url-shorten']['linkstore-partitioning'] = 'daily'
+
+    return patch_config
+
+
+@pytest.fixture(scope='session')
+def service_source_dir():
+    """Path to root directory service."""
+    return pathlib.Path(__file__).parent.parent
+
+
+@pytest.fixture(scope='session')
+def pgsql_local(service_source_dir, pgsql_local_create):
+    """Create schemas databases for tests"""
+    databases = discover.find_schemas(
+        'pg_service_template',  # service name that goes to the DB connection
+        [service_source_dir.joinpath('postgresql/schemas')],
+    )
+    return pgsql_local_create(list(databases.values()))
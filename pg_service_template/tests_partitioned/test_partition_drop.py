@@ -0,0 +1,50 @@
+import asyncio
+
+
+# Start the tests via `make test-debug` or `make test-release`
+
+# A daily partition whose period is long over, named like the service does
+ENDED_PARTITION = 'linkstore_p2000010100'
+
+
+async def _wait_dropped(monitor_client, expected):
+    # The cleaner runs every clean_db_period seconds, 10 by default
+    for _ in range(300):
+        metric = await monitor_client.single_metric(
+            'db-cleaner.partitions-dropped',
+        )
+        if metric.value >= expected:
+            return metric.value
+        await asyncio.sleep(0.1)
+    return metric.value
+
+
+async def test_ended_partition_is_dropped(
+        service_client, monitor_client, pgsql,
+):
+    # The service creates the partitioned linkstore on start
+    response = await service_client.put(
+        '/v1/shorten', data='http://example.com/partitioned',
+    )
+    assert response.status == 201
+
+    before = await monitor_client.single_metric(
+        'db-cleaner.partitions-dropped',
+    )
+    cursor = pgsql['db_1'].cursor()
+    cursor.execute(
+        f'create table {ENDED_PARTITION} partition of linkstore '
+        'for values from (\'2000-01-01\') to (\'2000-01-02\')',
+    )
+    cursor.execute(
+        f'insert into {ENDED_PARTITION} '
+        '(token, link, link_digest, create_time, expires_at, create_period) '
+        'values (\'ended\', \'http://example.com/ended\', \'\\x00\', '
+        '\'2000-01-01\', \'2000-01-01 12:00\', \'2000-01-01\')',
+    )
+
+    dropped = await _wait_dropped(monitor_client, before.value + 1)
+    assert dropped > before.value
+
+    cursor.execute(f'select to_regclass(\'{ENDED_PARTITION}\') is null')
+    assert cursor.fetchone()[0]